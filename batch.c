@@ -0,0 +1,292 @@
+/**
+ * Monte Carlo Batch Runner
+ *
+ * Runs many independent Wacky Store simulations across a pool of worker
+ * threads and aggregates the results into a single staffing report.
+ *
+ * Every store owns its lanes, its customers and its random number generator.
+ * Nothing is shared between stores while they run, so the result of a store
+ * depends only on its seed and the batch result does not depend on how many
+ * threads were used or which thread ran which store.
+ *
+ * Customers, carts and arrival bursts come from the workload generator in
+ * workload.c; its model is built once and shared read-only by every worker.
+ *
+ * Build: gcc -O2 -pthread batch.c -o batch -lm
+ * Usage: ./batch [stores] [threads] [seed] [min_lanes] [max_lanes] [rounds]
+ *
+ * Add -DWACKY_TRACE to also write a Perfetto timeline to batch_trace.json.
+ */
+#include "workload.c"
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define BATCH_MAX_LANES 64
+
+/**
+ * Results for a group of stores that share a lane count. Waits are kept as a
+ * histogram indexed by the number of rounds a customer spent in line, so
+ * groups can be merged by adding bins together.
+ */
+typedef struct BatchResult BatchResult;
+struct BatchResult {
+    long stores;
+    long customers;
+    long items;
+    long moves;
+    long* waits;
+};
+
+typedef struct BatchConfig BatchConfig;
+struct BatchConfig {
+    int stores;
+    int threads;
+    uint64_t seed;
+    int min_lanes;
+    int max_lanes;
+    int rounds;
+};
+
+/**
+ * Arrival rounds of the customers waiting in one lane, front of the lane
+ * first, in a ring buffer whose capacity is a power of two. simulate_store()
+ * keeps each one in step with its lane through queue(), balance_lanes() and
+ * process().
+ */
+typedef struct ArrivalQueue ArrivalQueue;
+struct ArrivalQueue {
+    int* rounds;
+    int head;
+    int count;
+    int capacity;
+};
+
+typedef struct BatchWorker BatchWorker;
+struct BatchWorker {
+    pthread_t thread;
+    BatchConfig* config;
+    WorkloadModel* model;
+    atomic_int* next_store;
+    BatchResult results[BATCH_MAX_LANES + 1];
+};
+
+static void arrivals_push(ArrivalQueue* queue, int round) {
+    if (queue->count == queue->capacity) {
+        int capacity = queue->capacity == 0 ? 64 : queue->capacity * 2;
+        int* rounds = (int*)malloc((size_t)capacity * sizeof(int));
+        if (rounds == NULL) exit(1);
+        for (int i = 0; i < queue->count; i++) {
+            rounds[i] = queue->rounds[(queue->head + i) & (queue->capacity - 1)];
+        }
+        free(queue->rounds);
+        queue->rounds = rounds;
+        queue->head = 0;
+        queue->capacity = capacity;
+    }
+    queue->rounds[(queue->head + queue->count) & (queue->capacity - 1)] = round;
+    queue->count++;
+}
+
+static int arrivals_pop_front(ArrivalQueue* queue) {
+    int round = queue->rounds[queue->head];
+    queue->head = (queue->head + 1) & (queue->capacity - 1);
+    queue->count--;
+    return round;
+}
+
+static int arrivals_pop_back(ArrivalQueue* queue) {
+    queue->count--;
+    return queue->rounds[(queue->head + queue->count) & (queue->capacity - 1)];
+}
+
+/**
+ * Function: simulate_store
+ * ------------------------
+ * Run a single store for the configured number of rounds and add its numbers
+ * into the result slot for its lane count.
+ *
+ * Each lane's arrival rounds are kept in an ArrivalQueue alongside it, so the
+ * wait of the customer process() serves is known without looking at them.
+ */
+static void simulate_store(BatchConfig* config, WorkloadModel* model, int store,
+                           BatchResult* results) {
+    Workload workload;
+    workload_init(&workload, model, config->seed ^ splitmix64((uint64_t)store));
+
+    int number_of_lanes = config->min_lanes +
+                          workload_lane(&workload, config->max_lanes - config->min_lanes + 1);
+    BatchResult* result = &results[number_of_lanes];
+    CheckoutLane* lanes[BATCH_MAX_LANES];
+    ArrivalQueue arrivals[BATCH_MAX_LANES];
+    memset(arrivals, 0, sizeof(arrivals));
+    for (int i = 0; i < number_of_lanes; i++) {
+        lanes[i] = open_new_checkout_line();
+    }
+
+    for (int round = 0; round < config->rounds; round++) {
+        int arriving = workload_arrivals(&workload);
+        for (int i = 0; i < arriving; i++) {
+            Customer* customer = new_customer("Shopper");
+            workload_fill_cart(&workload, customer);
+            int lane = workload_lane(&workload, number_of_lanes);
+            queue(customer, lanes[lane]);
+            arrivals_push(&arrivals[lane], round);
+        }
+
+        while (true) {
+            // balance_lanes() moves the last customer of the first busiest
+            // lane to the first least busy one; pick the same two lanes.
+            int most_busy = 0;
+            int least_busy = 0;
+            for (int i = 1; i < number_of_lanes; i++) {
+                if (arrivals[i].count > arrivals[most_busy].count) most_busy = i;
+                if (arrivals[i].count < arrivals[least_busy].count) least_busy = i;
+            }
+            if (!balance_lanes(lanes, number_of_lanes)) break;
+            arrivals_push(&arrivals[least_busy], arrivals_pop_back(&arrivals[most_busy]));
+            result->moves++;
+        }
+
+        for (int i = 0; i < number_of_lanes; i++) {
+            if (lanes[i]->first == NULL) continue;
+            int wait = round - arrivals_pop_front(&arrivals[i]);
+            result->waits[wait]++;
+            result->customers++;
+            result->items += process(lanes[i]);
+        }
+    }
+
+    result->stores++;
+    close_store(lanes, number_of_lanes);
+    for (int i = 0; i < number_of_lanes; i++) {
+        free(arrivals[i].rounds);
+    }
+}
+
+static void* batch_worker_main(void* arg) {
+    BatchWorker* worker = (BatchWorker*)arg;
+    BatchConfig* config = worker->config;
+
+    int store;
+    while ((store = atomic_fetch_add(worker->next_store, 1)) < config->stores) {
+        simulate_store(config, worker->model, store, worker->results);
+    }
+    customer_pool_trim();
+    return NULL;
+}
+
+static void result_merge(BatchResult* into, BatchResult* from, int rounds) {
+    into->stores += from->stores;
+    into->customers += from->customers;
+    into->items += from->items;
+    into->moves += from->moves;
+    for (int i = 0; i < rounds; i++) {
+        into->waits[i] += from->waits[i];
+    }
+}
+
+/**
+ * Function: wait_percentile
+ * -------------------------
+ * Return the smallest wait (in rounds) that at least pct percent of the served
+ * customers did not exceed. Return 0 if nobody was served.
+ */
+static int wait_percentile(BatchResult* result, int rounds, int pct) {
+    if (result->customers == 0) return 0;
+    long target = (result->customers * pct + 99) / 100;
+    long seen = 0;
+    for (int i = 0; i < rounds; i++) {
+        seen += result->waits[i];
+        if (seen >= target) return i;
+    }
+    return rounds - 1;
+}
+
+static void print_result_row(char* label, BatchResult* result, int rounds) {
+    printf("%-6s %7ld %10ld %12ld %9ld %5d %5d %5d\n", label, result->stores,
+           result->customers, result->items, result->moves,
+           wait_percentile(result, rounds, 50), wait_percentile(result, rounds, 90),
+           wait_percentile(result, rounds, 99));
+}
+
+int main(int argc, char* argv[]) {
+    BatchConfig config = {1000, 4, 1, 2, 8, 500};
+    if (argc > 1) config.stores = atoi(argv[1]);
+    if (argc > 2) config.threads = atoi(argv[2]);
+    if (argc > 3) config.seed = strtoull(argv[3], NULL, 10);
+    if (argc > 4) config.min_lanes = atoi(argv[4]);
+    if (argc > 5) config.max_lanes = atoi(argv[5]);
+    if (argc > 6) config.rounds = atoi(argv[6]);
+
+    if (config.stores < 0 || config.threads < 1 || config.rounds < 1 ||
+        config.min_lanes < 1 || config.max_lanes > BATCH_MAX_LANES ||
+        config.min_lanes > config.max_lanes) {
+        fprintf(stderr, "usage: %s [stores] [threads] [seed] [min_lanes] [max_lanes<=%d] [rounds]\n",
+                argv[0], BATCH_MAX_LANES);
+        return 1;
+    }
+
+    WorkloadConfig workload_config = workload_default_config();
+    WorkloadModel model;
+    if (!workload_model_init(&model, &workload_config)) exit(1);
+
+    atomic_int next_store = 0;
+    BatchWorker* workers = (BatchWorker*)calloc((size_t)config.threads, sizeof(BatchWorker));
+    if (workers == NULL) exit(1);
+
+    for (int t = 0; t < config.threads; t++) {
+        workers[t].config = &config;
+        workers[t].model = &model;
+        workers[t].next_store = &next_store;
+        for (int l = config.min_lanes; l <= config.max_lanes; l++) {
+            workers[t].results[l].waits = (long*)calloc((size_t)config.rounds, sizeof(long));
+            if (workers[t].results[l].waits == NULL) exit(1);
+        }
+        if (pthread_create(&workers[t].thread, NULL, batch_worker_main, &workers[t]) != 0) {
+            fprintf(stderr, "failed to start worker %d\n", t);
+            return 1;
+        }
+    }
+
+    BatchResult total = {0, 0, 0, 0, NULL};
+    total.waits = (long*)calloc((size_t)config.rounds, sizeof(long));
+    if (total.waits == NULL) exit(1);
+
+    for (int t = 0; t < config.threads; t++) {
+        pthread_join(workers[t].thread, NULL);
+    }
+
+    printf("%d stores, %d threads, seed %llu, %d rounds\n\n", config.stores,
+           config.threads, (unsigned long long)config.seed, config.rounds);
+    printf("%-6s %7s %10s %12s %9s %5s %5s %5s\n", "lanes", "stores", "customers",
+           "items", "moves", "p50", "p90", "p99");
+
+    // Fold every worker into worker 0, lane count by lane count.
+    for (int l = config.min_lanes; l <= config.max_lanes; l++) {
+        BatchResult* row = &workers[0].results[l];
+        for (int t = 1; t < config.threads; t++) {
+            result_merge(row, &workers[t].results[l], config.rounds);
+        }
+        if (row->stores == 0) continue;
+
+        char label[16];
+        snprintf(label, sizeof(label), "%d", l);
+        print_result_row(label, row, config.rounds);
+        result_merge(&total, row, config.rounds);
+    }
+    print_result_row("all", &total, config.rounds);
+
+#ifdef WACKY_TRACE
+    if (trace_export("batch_trace.json")) printf("\ntrace written to batch_trace.json\n");
+#endif
+
+    for (int t = 0; t < config.threads; t++) {
+        for (int l = config.min_lanes; l <= config.max_lanes; l++) {
+            free(workers[t].results[l].waits);
+        }
+    }
+    free(workers);
+    free(total.waits);
+    workload_model_free(&model);
+    return 0;
+}
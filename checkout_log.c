@@ -0,0 +1,431 @@
+/**
+ * Write-Ahead Checkout Log
+ *
+ * An append-only record of every completed checkout (customer name, items,
+ * timestamp) so a crash mid-shift does not lose the day's sales.
+ *
+ * Cashiers append records to an in-memory buffer and carry on. A background
+ * writer thread swaps that buffer out every commit interval and writes the
+ * whole batch with one write(), followed by one fdatasync() when the log is
+ * durable, so many checkouts share the cost of a single commit.
+ *
+ * Durability settings:
+ *
+ *   CHECKOUT_LOG_ASYNC  write every interval, never sync. Survives the process
+ *                       crashing, not the machine losing power.
+ *   CHECKOUT_LOG_GROUP  sync every interval. A power loss costs at most the
+ *                       last interval of checkouts; cashiers never wait.
+ *   CHECKOUT_LOG_SYNC   a checkout returns only once its record is synced.
+ *                       Concurrent cashiers waiting at the same time share one
+ *                       sync (classic group commit).
+ *
+ * Opening an existing log continues its sequence numbers. A record cut short
+ * or failing its checksum at the end (what a crash mid-write leaves behind) is
+ * truncated away first, so new records follow straight on from the last
+ * intact one. Only a bad record that runs to the end of the file counts as
+ * torn; one with more of the log after it is corruption, and the log is left
+ * alone and not opened, so checkout_log_tool.c can still recover the rest.
+ *
+ * Record layout (host byte order), see checkout_log_tool.c for recovery:
+ *
+ *   uint32 length      bytes in the whole record, this field included
+ *   uint32 checksum    FNV-1a over everything after this field
+ *   uint64 sequence    1, 2, 3, ... in commit order
+ *   int64  timestamp   CLOCK_REALTIME in nanoseconds
+ *   int32  items       total_number_of_items() at checkout
+ *   char   name[]      customer name, not NUL-terminated
+ *
+ * Link with -pthread.
+ */
+#ifndef CHECKOUT_LOG_C
+#define CHECKOUT_LOG_C
+
+#include "wackystore.c"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CHECKOUT_LOG_ASYNC 0
+#define CHECKOUT_LOG_GROUP 1
+#define CHECKOUT_LOG_SYNC 2
+
+#define CHECKOUT_RECORD_HEADER 28
+#define CHECKOUT_LOG_INITIAL_BUFFER (1024 * 1024)
+// Cashiers wait for the writer once this much is waiting to be written.
+#define CHECKOUT_LOG_MAX_PENDING (64 * 1024 * 1024)
+
+typedef struct CheckoutLog CheckoutLog;
+struct CheckoutLog {
+    int fd;
+    int durability;
+    long interval_us;
+
+    pthread_mutex_t lock;
+    pthread_cond_t wake_writer;
+    pthread_cond_t committed;
+    pthread_t writer;
+
+    // Records appended since the last swap. Guarded by lock.
+    unsigned char* pending;
+    size_t pending_length;
+    size_t pending_capacity;
+    int sync_waiters;
+    bool stopping;
+    bool failed;
+
+    uint64_t last_sequence;      // last sequence number handed out
+    uint64_t durable_sequence;   // last sequence number written (and synced)
+
+    // Owned by the writer thread between swaps.
+    unsigned char* writing;
+    size_t writing_capacity;
+};
+
+static uint32_t checkout_log_checksum(const unsigned char* data, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static int64_t checkout_log_now() {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static bool checkout_log_write_all(int fd, const unsigned char* data, size_t length) {
+    size_t written = 0;
+    while (written < length) {
+        ssize_t n = write(fd, data + written, length - written);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        written += (size_t)n;
+    }
+    return true;
+}
+
+typedef struct CheckoutRecord CheckoutRecord;
+struct CheckoutRecord {
+    uint32_t length;
+    uint64_t sequence;
+    int64_t timestamp;
+    int items;
+};
+
+/**
+ * Function: checkout_log_read_record
+ * ----------------------------------
+ * Read the next record from file into record. Return false at the end of the
+ * file or at a record that is cut short or fails its checksum.
+ */
+bool checkout_log_read_record(FILE* file, CheckoutRecord* record) {
+    unsigned char data[CHECKOUT_RECORD_HEADER + MAX_NAME_LENGTH];
+    uint32_t length;
+    uint32_t checksum;
+    if (fread(data, 1, 4, file) != 4) return false;
+    memcpy(&length, data, 4);
+    if (length < CHECKOUT_RECORD_HEADER || length > sizeof(data) ||
+        fread(data + 4, 1, length - 4, file) != length - 4) {
+        return false;
+    }
+    memcpy(&checksum, data + 4, 4);
+    if (checksum != checkout_log_checksum(data + 8, length - 8)) return false;
+
+    record->length = length;
+    memcpy(&record->sequence, data + 8, 8);
+    memcpy(&record->timestamp, data + 16, 8);
+    memcpy(&record->items, data + 24, 4);
+    return true;
+}
+
+/**
+ * Function: checkout_log_resume
+ * -----------------------------
+ * Find the last intact record of the log at path, open on fd, and set
+ * *last_sequence to its sequence number (0 for an empty log). If the next
+ * record is the last thing in the file (its length, when there is a whole
+ * length field, reaches the end) it is a torn write and is truncated;
+ * otherwise a record in the middle of the log is damaged, and nothing is
+ * truncated. Either way the number of bytes after the last intact record is
+ * printed. Return false, with the error printed, if the log could
+ * not be read or truncated or is damaged.
+ */
+static bool checkout_log_resume(int fd, char* path, uint64_t* last_sequence) {
+    int read_fd = dup(fd);
+    FILE* file = read_fd < 0 ? NULL : fdopen(read_fd, "rb");
+    if (file == NULL) {
+        perror(path);
+        if (read_fd >= 0) close(read_fd);
+        return false;
+    }
+
+    CheckoutRecord record;
+    off_t intact = 0;
+    *last_sequence = 0;
+    while (checkout_log_read_record(file, &record)) {
+        *last_sequence = record.sequence;
+        intact += record.length;
+    }
+    bool ok = !ferror(file);
+    fclose(file);
+
+    off_t size = lseek(fd, 0, SEEK_END);
+    if (!ok || size < 0) {
+        perror(path);
+        return false;
+    }
+    if (size == intact) return true;
+    uint32_t length = 0;
+    bool torn = size - intact < 4;
+    if (!torn) {
+        if (pread(fd, &length, 4, intact) != 4) {
+            perror(path);
+            return false;
+        }
+        torn = length >= CHECKOUT_RECORD_HEADER && length <= CHECKOUT_RECORD_HEADER + MAX_NAME_LENGTH &&
+               intact + (off_t)length >= size;
+    }
+    if (!torn) {
+        fprintf(stderr, "%s: damaged record at byte %lld with %lld bytes after it; not opening the log\n",
+                path, (long long)intact, (long long)(size - intact));
+        return false;
+    }
+    fprintf(stderr, "%s: dropping %lld bytes of a torn record at the end\n", path,
+            (long long)(size - intact));
+    if (ftruncate(fd, intact) != 0) {
+        perror(path);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Function: checkout_log_writer
+ * -----------------------------
+ * Background thread: once a record arrives, wait out one commit interval (cut
+ * short if a cashier is waiting on the commit), take everything pending, write
+ * and sync it, then wake anyone who was waiting for it.
+ */
+static void* checkout_log_writer(void* arg) {
+    CheckoutLog* log = (CheckoutLog*)arg;
+
+    pthread_mutex_lock(&log->lock);
+    while (true) {
+        while (!log->stopping && log->pending_length == 0) {
+            pthread_cond_wait(&log->wake_writer, &log->lock);
+        }
+        // Give other cashiers one interval to join this batch.
+        if (!log->stopping && log->interval_us > 0) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += (log->interval_us % 1000000) * 1000;
+            deadline.tv_sec += log->interval_us / 1000000 + deadline.tv_nsec / 1000000000;
+            deadline.tv_nsec %= 1000000000;
+            while (!log->stopping && log->sync_waiters == 0 &&
+                   log->pending_length < CHECKOUT_LOG_MAX_PENDING) {
+                if (pthread_cond_timedwait(&log->wake_writer, &log->lock, &deadline) == ETIMEDOUT) break;
+            }
+        }
+        // Only reachable once stopping with nothing left to write.
+        if (log->pending_length == 0) break;
+
+        // Swap buffers so cashiers can keep appending while we write.
+        unsigned char* batch = log->pending;
+        size_t batch_length = log->pending_length;
+        size_t batch_capacity = log->pending_capacity;
+        uint64_t batch_sequence = log->last_sequence;
+        log->pending = log->writing;
+        log->pending_capacity = log->writing_capacity;
+        log->pending_length = 0;
+        log->writing = batch;
+        log->writing_capacity = batch_capacity;
+        pthread_cond_broadcast(&log->committed);
+        pthread_mutex_unlock(&log->lock);
+
+        bool ok = checkout_log_write_all(log->fd, batch, batch_length);
+        if (ok && log->durability != CHECKOUT_LOG_ASYNC) ok = fdatasync(log->fd) == 0;
+
+        pthread_mutex_lock(&log->lock);
+        if (ok) log->durable_sequence = batch_sequence;
+        else log->failed = true;
+        pthread_cond_broadcast(&log->committed);
+    }
+    pthread_mutex_unlock(&log->lock);
+    return NULL;
+}
+
+/**
+ * Function: checkout_log_open
+ * ---------------------------
+ * Open (or create) the log at path for appending and start its writer thread.
+ * interval_us is the time between commits. Sequence numbers carry on from the
+ * last intact record already in the log. Return NULL if the file cannot be
+ * opened or read, or a record before its torn tail is damaged; the error is
+ * printed.
+ */
+CheckoutLog* checkout_log_open(char* path, int durability, long interval_us) {
+    int fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) {
+        perror(path);
+        return NULL;
+    }
+    uint64_t last_sequence;
+    if (!checkout_log_resume(fd, path, &last_sequence)) {
+        close(fd);
+        return NULL;
+    }
+
+    CheckoutLog* log = (CheckoutLog*)calloc(1, sizeof(CheckoutLog));
+    if (log == NULL) exit(1);
+    log->fd = fd;
+    log->durability = durability;
+    log->interval_us = interval_us < 0 ? 0 : interval_us;
+    log->last_sequence = last_sequence;
+    log->durable_sequence = last_sequence;
+    log->pending = (unsigned char*)malloc(CHECKOUT_LOG_INITIAL_BUFFER);
+    log->writing = (unsigned char*)malloc(CHECKOUT_LOG_INITIAL_BUFFER);
+    if (log->pending == NULL || log->writing == NULL) exit(1);
+    log->pending_capacity = CHECKOUT_LOG_INITIAL_BUFFER;
+    log->writing_capacity = CHECKOUT_LOG_INITIAL_BUFFER;
+
+    pthread_mutex_init(&log->lock, NULL);
+    pthread_cond_init(&log->wake_writer, NULL);
+    pthread_cond_init(&log->committed, NULL);
+    if (pthread_create(&log->writer, NULL, checkout_log_writer, log) != 0) exit(1);
+    return log;
+}
+
+/**
+ * Function: checkout_log_append
+ * -----------------------------
+ * Add one checkout record to the pending batch and return its sequence number.
+ * Under CHECKOUT_LOG_SYNC, wait until the record has been synced.
+ */
+uint64_t checkout_log_append(CheckoutLog* log, const char* name, size_t name_length, int items) {
+    unsigned char record[CHECKOUT_RECORD_HEADER + MAX_NAME_LENGTH];
+    uint32_t length = (uint32_t)(CHECKOUT_RECORD_HEADER + name_length);
+    int64_t timestamp = checkout_log_now();
+
+    memcpy(record + 0, &length, 4);
+    memcpy(record + 16, &timestamp, 8);
+    memcpy(record + 24, &items, 4);
+    memcpy(record + CHECKOUT_RECORD_HEADER, name, name_length);
+
+    pthread_mutex_lock(&log->lock);
+    while (log->pending_length >= CHECKOUT_LOG_MAX_PENDING && !log->failed) {
+        pthread_cond_signal(&log->wake_writer);
+        pthread_cond_wait(&log->committed, &log->lock);
+    }
+    uint64_t sequence = ++log->last_sequence;
+    memcpy(record + 8, &sequence, 8);
+    uint32_t checksum = checkout_log_checksum(record + 8, length - 8);
+    memcpy(record + 4, &checksum, 4);
+
+    // The writer sleeps while nothing is pending; the first record wakes it.
+    if (log->pending_length == 0) pthread_cond_signal(&log->wake_writer);
+    if (log->pending_capacity - log->pending_length < length) {
+        log->pending_capacity *= 2;
+        log->pending = (unsigned char*)realloc(log->pending, log->pending_capacity);
+        if (log->pending == NULL) exit(1);
+    }
+    memcpy(log->pending + log->pending_length, record, length);
+    log->pending_length += length;
+
+    if (log->durability == CHECKOUT_LOG_SYNC) {
+        log->sync_waiters++;
+        pthread_cond_signal(&log->wake_writer);
+        while (log->durable_sequence < sequence && !log->failed) {
+            pthread_cond_wait(&log->committed, &log->lock);
+        }
+        log->sync_waiters--;
+    }
+    pthread_mutex_unlock(&log->lock);
+    return sequence;
+}
+
+/**
+ * Function: logged_process
+ * ------------------------
+ * process() the lane, recording the checkout in the log first-served order.
+ * Empty lanes are not logged.
+ */
+int logged_process(CheckoutLog* log, CheckoutLane* lane) {
+    if (lane == NULL || lane->first == NULL) return 0;
+
+    // The customer is freed by process(), so keep the name until we log it.
+    char name[MAX_NAME_LENGTH];
+    size_t name_length = (size_t)lane->first->customer->name_length;
+    memcpy(name, lane->first->customer->name, name_length);
+
+    int amount = process(lane);
+    checkout_log_append(log, name, name_length, amount);
+    return amount;
+}
+
+/**
+ * Function: logged_process_all_lanes
+ * ----------------------------------
+ * process_all_lanes(), logging every checkout it makes.
+ */
+int logged_process_all_lanes(CheckoutLog* log, CheckoutLane* lanes[], int number_of_lanes) {
+    int counter = 0;
+    for (int i = 0; i < number_of_lanes; i++) {
+        counter += logged_process(log, lanes[i]);
+    }
+    return counter;
+}
+
+/**
+ * Function: checkout_log_commit
+ * -----------------------------
+ * Block until every record appended so far is on disk (as far as the log's
+ * durability setting goes). Return false if a write or sync has failed.
+ */
+bool checkout_log_commit(CheckoutLog* log) {
+    pthread_mutex_lock(&log->lock);
+    uint64_t target = log->last_sequence;
+    log->sync_waiters++;
+    pthread_cond_signal(&log->wake_writer);
+    while (log->durable_sequence < target && !log->failed) {
+        pthread_cond_wait(&log->committed, &log->lock);
+    }
+    log->sync_waiters--;
+    bool ok = !log->failed;
+    pthread_mutex_unlock(&log->lock);
+    return ok;
+}
+
+/**
+ * Function: checkout_log_close
+ * ----------------------------
+ * Commit everything still pending, stop the writer and free the log.
+ * Return false if any record could not be written.
+ */
+bool checkout_log_close(CheckoutLog* log) {
+    pthread_mutex_lock(&log->lock);
+    log->stopping = true;
+    pthread_cond_signal(&log->wake_writer);
+    pthread_mutex_unlock(&log->lock);
+    pthread_join(log->writer, NULL);
+
+    bool ok = !log->failed;
+    if (ok && log->durability != CHECKOUT_LOG_ASYNC) ok = fsync(log->fd) == 0;
+    close(log->fd);
+    pthread_mutex_destroy(&log->lock);
+    pthread_cond_destroy(&log->wake_writer);
+    pthread_cond_destroy(&log->committed);
+    free(log->pending);
+    free(log->writing);
+    free(log);
+    return ok;
+}
+
+#endif
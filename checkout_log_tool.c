@@ -0,0 +1,209 @@
+/**
+ * Checkout Log Tool
+ *
+ *   recover <log>
+ *       Replay a checkout log written by checkout_log.c and rebuild the sales
+ *       totals. Reading stops at the first record that is cut short or fails
+ *       its checksum, which is what a crash in the middle of a write leaves
+ *       behind; everything before it is intact.
+ *
+ *   bench <log> [checkouts] [threads] [interval_us]
+ *       Measure checkouts per second with no log and at each durability
+ *       setting. Every thread runs its own store; all of them share one log.
+ *
+ * Build: gcc -O2 -pthread checkout_log_tool.c -o checkout_log_tool -lm
+ */
+#include "checkout_log.c"
+#include "workload.c"
+
+#define BENCH_LANES 8
+
+typedef struct RecoveredTotals RecoveredTotals;
+struct RecoveredTotals {
+    long checkouts;
+    long items;
+    uint64_t last_sequence;
+    int64_t first_timestamp;
+    int64_t last_timestamp;
+    long bytes_used;
+    long bytes_ignored;
+};
+
+/**
+ * Function: recover_log
+ * ---------------------
+ * Read every intact record from the log at path into totals. Return false if
+ * the file could not be read at all.
+ */
+static bool recover_log(char* path, RecoveredTotals* totals) {
+    memset(totals, 0, sizeof(RecoveredTotals));
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        perror(path);
+        return false;
+    }
+
+    CheckoutRecord record;
+    while (checkout_log_read_record(file, &record)) {
+        if (totals->checkouts == 0) totals->first_timestamp = record.timestamp;
+        totals->last_timestamp = record.timestamp;
+        totals->last_sequence = record.sequence;
+        totals->checkouts++;
+        totals->items += record.items;
+        totals->bytes_used += record.length;
+    }
+
+    fseek(file, 0, SEEK_END);
+    totals->bytes_ignored = ftell(file) - totals->bytes_used;
+    fclose(file);
+    return true;
+}
+
+typedef struct BenchThread BenchThread;
+struct BenchThread {
+    pthread_t thread;
+    CheckoutLog* log;
+    WorkloadModel* model;
+    uint64_t seed;
+    long checkouts;
+    long items;
+};
+
+/**
+ * Function: bench_thread_main
+ * ---------------------------
+ * Fill a store with shoppers and check out the requested number of them,
+ * through the log when there is one.
+ */
+static void* bench_thread_main(void* arg) {
+    BenchThread* bench = (BenchThread*)arg;
+    Workload workload;
+    workload_init(&workload, bench->model, bench->seed);
+
+    CheckoutLane* lanes[BENCH_LANES];
+    for (int i = 0; i < BENCH_LANES; i++) {
+        lanes[i] = open_new_checkout_line();
+    }
+
+    long served = 0;
+    while (served < bench->checkouts) {
+        for (int i = 0; i < BENCH_LANES; i++) {
+            Customer* customer = new_customer(workload_customer_name(&workload));
+            workload_fill_cart(&workload, customer);
+            queue(customer, lanes[i]);
+        }
+        if (bench->log != NULL) {
+            bench->items += logged_process_all_lanes(bench->log, lanes, BENCH_LANES);
+        } else {
+            bench->items += process_all_lanes(lanes, BENCH_LANES);
+        }
+        served += BENCH_LANES;
+    }
+
+    close_store(lanes, BENCH_LANES);
+    customer_pool_trim();
+    return NULL;
+}
+
+static double now_seconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/**
+ * Function: bench_run
+ * -------------------
+ * Run one benchmark configuration and print its rate. durability < 0 means
+ * no log at all.
+ */
+static void bench_run(char* label, char* path, int durability, long interval_us,
+                      long checkouts, int threads, WorkloadModel* model) {
+    CheckoutLog* log = NULL;
+    if (durability >= 0) {
+        unlink(path);
+        log = checkout_log_open(path, durability, interval_us);
+        if (log == NULL) exit(1);
+    }
+
+    BenchThread* benches = (BenchThread*)calloc((size_t)threads, sizeof(BenchThread));
+    if (benches == NULL) exit(1);
+
+    double start = now_seconds();
+    for (int t = 0; t < threads; t++) {
+        benches[t].log = log;
+        benches[t].model = model;
+        benches[t].seed = (uint64_t)t + 1;
+        benches[t].checkouts = checkouts / threads;
+        if (pthread_create(&benches[t].thread, NULL, bench_thread_main, &benches[t]) != 0) exit(1);
+    }
+    long items = 0;
+    for (int t = 0; t < threads; t++) {
+        pthread_join(benches[t].thread, NULL);
+        items += benches[t].items;
+    }
+    bool ok = log == NULL || checkout_log_close(log);
+    double elapsed = now_seconds() - start;
+
+    long served = 0;
+    for (int t = 0; t < threads; t++) {
+        served += (benches[t].checkouts + BENCH_LANES - 1) / BENCH_LANES * BENCH_LANES;
+    }
+    printf("%-8s %10ld checkouts %8.3f s %12.0f checkouts/s", label, served, elapsed, served / elapsed);
+
+    if (log != NULL) {
+        RecoveredTotals totals;
+        if (recover_log(path, &totals)) {
+            printf("  (log: %ld checkouts, %s)", totals.checkouts,
+                   ok && totals.checkouts == served && totals.items == items ? "totals match" : "MISMATCH");
+        }
+    }
+    printf("\n");
+    free(benches);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc >= 3 && strcmp(argv[1], "recover") == 0) {
+        RecoveredTotals totals;
+        if (!recover_log(argv[2], &totals)) return 1;
+        printf("checkouts:     %ld\n", totals.checkouts);
+        printf("items:         %ld\n", totals.items);
+        printf("last sequence: %llu\n", (unsigned long long)totals.last_sequence);
+        if (totals.checkouts > 0) {
+            printf("time span:     %.3f s\n", (totals.last_timestamp - totals.first_timestamp) / 1e9);
+        }
+        if (totals.bytes_ignored > 0) {
+            printf("ignored %ld bytes of incomplete or corrupt data at the end\n", totals.bytes_ignored);
+        }
+        return 0;
+    }
+
+    if (argc >= 3 && strcmp(argv[1], "bench") == 0) {
+        long checkouts = argc > 3 ? atol(argv[3]) : 200000;
+        int threads = argc > 4 ? atoi(argv[4]) : 4;
+        long interval_us = argc > 5 ? atol(argv[5]) : 1000;
+        if (checkouts < 1 || threads < 1) {
+            fprintf(stderr, "checkouts and threads must be positive\n");
+            return 1;
+        }
+
+        WorkloadConfig config = workload_default_config();
+        WorkloadModel model;
+        if (!workload_model_init(&model, &config)) exit(1);
+
+        printf("%d threads, commit interval %ld us\n", threads, interval_us);
+        bench_run("none", argv[2], -1, interval_us, checkouts, threads, &model);
+        bench_run("async", argv[2], CHECKOUT_LOG_ASYNC, interval_us, checkouts, threads, &model);
+        bench_run("group", argv[2], CHECKOUT_LOG_GROUP, interval_us, checkouts, threads, &model);
+        // Every checkout waits for a sync, so keep this run short.
+        long sync_checkouts = checkouts / 20 > threads * BENCH_LANES ? checkouts / 20 : threads * BENCH_LANES;
+        bench_run("sync", argv[2], CHECKOUT_LOG_SYNC, interval_us, sync_checkouts, threads, &model);
+
+        workload_model_free(&model);
+        return 0;
+    }
+
+    fprintf(stderr, "usage: %s recover <log>\n", argv[0]);
+    fprintf(stderr, "       %s bench <log> [checkouts] [threads] [interval_us]\n", argv[0]);
+    return 1;
+}
@@ -0,0 +1,115 @@
+/**
+ * Drain Benchmark
+ *
+ * Fills two identical stores from the same workload seed, then empties one by
+ * calling process_all_lanes() until every lane is empty and the other with a
+ * single drain_all_lanes() call. Checks that both give the same per-round and
+ * total item counts and reports the time per customer served.
+ *
+ * Build: gcc -O2 drain_bench.c -o drain_bench -lm
+ * Usage: ./drain_bench [lanes] [customers_per_lane] [seed]
+ */
+#include "workload.c"
+#include <time.h>
+
+static double seconds_since(struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/**
+ * Function: fill_store
+ * --------------------
+ * Open the lanes and queue customers onto random lanes, so that neighbouring
+ * customers in a lane are far apart in memory, as they are in a real run.
+ */
+static CheckoutLane** fill_store(WorkloadModel* model, uint64_t seed, int number_of_lanes,
+                                 int customers) {
+    CheckoutLane** lanes = (CheckoutLane**)calloc((size_t)number_of_lanes, sizeof(CheckoutLane*));
+    if (lanes == NULL) exit(1);
+    for (int i = 0; i < number_of_lanes; i++) {
+        lanes[i] = open_new_checkout_line();
+    }
+
+    Workload workload;
+    workload_init(&workload, model, seed);
+    for (int i = 0; i < customers; i++) {
+        Customer* customer = new_customer(workload_customer_name(&workload));
+        workload_fill_cart(&workload, customer);
+        queue(customer, lanes[workload_lane(&workload, number_of_lanes)]);
+    }
+    return lanes;
+}
+
+int main(int argc, char* argv[]) {
+    int number_of_lanes = argc > 1 ? atoi(argv[1]) : 256;
+    int per_lane = argc > 2 ? atoi(argv[2]) : 128;
+    uint64_t seed = argc > 3 ? strtoull(argv[3], NULL, 10) : 1;
+    if (number_of_lanes < 1 || per_lane < 1) {
+        fprintf(stderr, "usage: %s [lanes] [customers_per_lane] [seed]\n", argv[0]);
+        return 1;
+    }
+    int customers = number_of_lanes * per_lane;
+
+    WorkloadConfig config = workload_default_config();
+    config.cart_mean = 2.0;
+    WorkloadModel model;
+    if (!workload_model_init(&model, &config)) exit(1);
+
+    // Lanes are filled at random, so allow for some lanes running long.
+    int max_rounds = customers;
+    int* loop_rounds = (int*)calloc((size_t)max_rounds, sizeof(int));
+    int* drain_rounds = (int*)calloc((size_t)max_rounds, sizeof(int));
+    if (loop_rounds == NULL || drain_rounds == NULL) exit(1);
+    struct timespec start;
+
+    // Baseline: loop on process_all_lanes() until a round serves nobody.
+    CheckoutLane** lanes = fill_store(&model, seed, number_of_lanes, customers);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    long loop_total = 0;
+    int loop_count = 0;
+    while (true) {
+        bool any = false;
+        for (int i = 0; i < number_of_lanes && !any; i++) any = lanes[i]->first != NULL;
+        if (!any) break;
+        loop_rounds[loop_count] = process_all_lanes(lanes, number_of_lanes);
+        loop_total += loop_rounds[loop_count++];
+    }
+    double loop_time = seconds_since(&start);
+    close_store(lanes, number_of_lanes);
+    free(lanes);
+
+    // Rounds API, asking for exactly as many rounds as the baseline needed.
+    lanes = fill_store(&model, seed, number_of_lanes, customers);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    long rounds_total = process_all_lanes_rounds(lanes, number_of_lanes, loop_count, drain_rounds);
+    double rounds_time = seconds_since(&start);
+    bool rounds_match = rounds_total == loop_total &&
+                        memcmp(loop_rounds, drain_rounds, (size_t)loop_count * sizeof(int)) == 0;
+    close_store(lanes, number_of_lanes);
+    free(lanes);
+
+    // Drain API.
+    lanes = fill_store(&model, seed, number_of_lanes, customers);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int drain_count = 0;
+    long drain_total = drain_all_lanes(lanes, number_of_lanes, &drain_count);
+    double drain_time = seconds_since(&start);
+    close_store(lanes, number_of_lanes);
+    free(lanes);
+
+    printf("%d lanes, %d customers, %d rounds\n", number_of_lanes, customers, loop_count);
+    printf("process_all_lanes loop:   %.3f s, %6.1f ns/customer, %ld items\n", loop_time,
+           loop_time * 1e9 / customers, loop_total);
+    printf("process_all_lanes_rounds: %.3f s, %6.1f ns/customer, %ld items, per-round %s\n",
+           rounds_time, rounds_time * 1e9 / customers, rounds_total, rounds_match ? "match" : "MISMATCH");
+    printf("drain_all_lanes:          %.3f s, %6.1f ns/customer, %ld items, %s\n", drain_time,
+           drain_time * 1e9 / customers, drain_total,
+           drain_total == loop_total && drain_count == loop_count ? "match" : "MISMATCH");
+
+    free(loop_rounds);
+    free(drain_rounds);
+    workload_model_free(&model);
+    return rounds_match && drain_total == loop_total && drain_count == loop_count ? 0 : 1;
+}
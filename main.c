@@ -1,4 +1,7 @@
 #include "wackystore.c"
+#include "report.c"
+#include "snapshot.c"
+#include "zones.c"
 #include <assert.h>
 #include <time.h>
 
@@ -64,6 +67,10 @@ void test_many_items_in_cart() {
     
 }
 
+bool is_bulk_item(ItemNode* item) {
+    return item->count >= 100;
+}
+
 void test_single_checkout_lane() {
     Customer* charles = new_customer("Charles");
     add_item_to_cart(charles, "RP", 10000);
@@ -473,6 +480,135 @@ int main(void) {
     printf("\n");
     **/
    
+    // R31 - report_customer() Matches print_customer() Case
+    Report report;
+    report_init(&report, STDOUT_FILENO);
+    Customer* c4 = new_customer("Receipt");
+    add_item_to_cart(c4, "Bananas", 7);
+    add_item_to_cart(c4, "Apples", 2147483000);
+    char expected[256];
+    int expected_length = snprintf(expected, sizeof(expected),
+                                   "Customer: %s\n  Cart [%d]:\n    - %s x %d\n    - %s x %d\n\n",
+                                   "Receipt", 2147483007, "Apples", 2147483000, "Bananas", 7);
+    report_customer(&report, c4);
+    if (report.length == (size_t)expected_length && memcmp(report.buffer, expected, report.length) == 0) printf("R31 - report_customer() Matches print_customer() Case Passed.\n\n");
+    report.length = 0;
+    free_customer(c4);
+
+    // R32 - report_lane() Matches print_customers_in_lane() Case
+    expected_length = snprintf(expected, sizeof(expected), "Lane %s:\n\t-> %s \n", "Lane 6", "Peter");
+    report_lane(&report, "Lane 6", lanes[5]);
+    if (report.length == (size_t)expected_length && memcmp(report.buffer, expected, report.length) == 0) printf("R32 - report_lane() Matches print_customers_in_lane() Case Passed.\n\n");
+    report.length = 0;
+    report_free(&report);
+
+    // R33 - snap_read_begin() Snapshot Isolation Case
+    SnapStore* snap = snap_open_store(2);
+    SnapReader reader;
+    snap_reader_init(&reader, snap);
+    Customer* c5 = snap_new_customer("Snapshot");
+    snap_add_item(snap, c5, "Bananas", 4);
+    snap_add_item(snap, c5, "Apples", 3);
+    snap_queue(snap, c5, 0);
+    snap_queue(snap, snap_new_customer("Extra 1"), 0);
+    snap_queue(snap, snap_new_customer("Extra 2"), 0);
+    StoreVersion* seen = snap_read_begin(&reader);
+    ItemNode* seen_cart = snap_cart(seen->lanes[0]->customers[0]);
+    snap_add_item(snap, c5, "Apples", 10);
+    snap_remove_item(snap, c5, "Bananas", 4);
+    snap_balance_lanes(snap);
+    int served = snap_process(snap, 0);
+    if (served == 13 && seen->lanes[0]->count == 3 && seen->lanes[1]->count == 0 &&
+        seen_cart->count == 3 && seen_cart->next->count == 4 &&
+        snap_total_number_of_items(seen->lanes[0]->customers[0]) == 13) printf("R33 - snap_read_begin() Snapshot Isolation Case Passed.\n\n");
+    snap_read_end(&reader);
+
+    // R34 - snap_read_begin() Sees Published Writes Case
+    StoreVersion* latest = snap_read_begin(&reader);
+    if (latest->lanes[0]->count == 1 && latest->lanes[1]->count == 1 &&
+        strcmp(latest->lanes[1]->customers[0]->name, "Extra 2") == 0) printf("R34 - snap_read_begin() Sees Published Writes Case Passed.\n\n");
+    snap_read_end(&reader);
+    snap_reader_release(&reader);
+    snap_close_store(snap);
+
+    // R35 - merge_carts() Shared Item Case
+    Customer* parent = new_customer("Parent");
+    Customer* child = new_customer("Child");
+    add_item_to_cart(parent, "Bread", 1);
+    add_item_to_cart(parent, "Milk", 2);
+    add_item_to_cart(child, "Apples", 5);
+    add_item_to_cart(child, "Milk", 3);
+    add_item_to_cart(child, "Zucchini", 4);
+    ItemNode* parent_milk = parent->cart->next;
+    merge_carts(parent, child);
+    if (child->cart == NULL && total_number_of_items(parent) == 15 &&
+        strcmp(parent->cart->name, "Apples") == 0 &&
+        strcmp(parent->cart->next->name, "Bread") == 0 &&
+        parent->cart->next->next == parent_milk && parent_milk->count == 5 &&
+        strcmp(parent_milk->next->name, "Zucchini") == 0 && parent_milk->next->next == NULL) printf("R35 - merge_carts() Shared Item Case Passed.\n\n");
+    free_customer(child);
+
+    // R36 - split_cart() Bulk Item Case
+    add_item_to_cart(parent, "Water", 120);
+    add_item_to_cart(parent, "Bread", 499);
+    Customer* bulk = split_cart(parent, is_bulk_item);
+    if (total_number_of_items(parent) == 14 && total_number_of_items(bulk) == 620 &&
+        strcmp(bulk->name, "Parent") == 0 &&
+        strcmp(bulk->cart->name, "Bread") == 0 && strcmp(bulk->cart->next->name, "Water") == 0 &&
+        bulk->cart->next->next == NULL &&
+        strcmp(parent->cart->name, "Apples") == 0 && strcmp(parent->cart->next->name, "Milk") == 0) printf("R36 - split_cart() Bulk Item Case Passed.\n\n");
+    free_customer(parent);
+    free_customer(bulk);
+
+    // R37 - process_all_lanes_rounds() Matches process_all_lanes() Case
+    CheckoutLane* drain_lanes[] = {open_new_checkout_line(), open_new_checkout_line(),
+                                   open_new_checkout_line()};
+    int amounts[] = {3, 0, 7, 11, 2, 5};
+    for (int i = 0; i < 6; i++) {
+        Customer* shopper = new_customer("Drain");
+        add_item_to_cart(shopper, "Eggs", amounts[i]);
+        queue(shopper, drain_lanes[i % 2 == 0 ? 0 : 2]);
+    }
+    int per_round[2];
+    int two_rounds = process_all_lanes_rounds(drain_lanes, 3, 2, per_round);
+    if (two_rounds == 21 && per_round[0] == 3 && per_round[1] == 18) printf("R37 - process_all_lanes_rounds() Matches process_all_lanes() Case Passed.\n\n");
+
+    // R38 - drain_all_lanes() Empties Every Lane Case
+    int drain_rounds = 0;
+    int drained = drain_all_lanes(drain_lanes, 3, &drain_rounds);
+    if (drained == 7 && drain_rounds == 1 && drain_lanes[0]->first == NULL && drain_lanes[2]->first == NULL &&
+        drain_all_lanes(drain_lanes, 3, &drain_rounds) == 0 && drain_rounds == 0) printf("R38 - drain_all_lanes() Empties Every Lane Case Passed.\n\n");
+    close_store(drain_lanes, 3);
+
+    // R39 - Zoned Store Within-Zone Balancing Case
+    int zone_lanes[] = {2, 3};
+    ZonedStore* zoned = open_zoned_store(2, zone_lanes, 2, 2);
+    for (int i = 0; i < 3; i++) {
+        Customer* shopper = new_customer("Zoned");
+        add_item_to_cart(shopper, "Bread", i + 1);
+        zoned_queue(zoned, 0, 0, shopper);
+    }
+    zoned_queue(zoned, 1, 0, new_customer("Idle"));
+    int zoned_moved = balance_zoned_store(zoned);
+    if (zoned_moved == 1 && total_number_of_customers(zoned->zones[0].lanes[0]) == 2 &&
+        total_number_of_customers(zoned->zones[0].lanes[1]) == 1 && zoned->zones[0].customers == 3 &&
+        zoned->zones[1].customers == 1) printf("R39 - Zoned Store Within-Zone Balancing Case Passed.\n\n");
+
+    // R40 - Zoned Store Cross-Zone Escalation Case
+    for (int i = 0; i < 5; i++) {
+        zoned_queue(zoned, 0, 1, new_customer("Rush"));
+    }
+    // Zone 0 now has 4 customers per lane against zone 1's 1/3, more than 2 apart.
+    zoned_moved = balance_zoned_store(zoned);
+    bool escalated = zoned_moved == 2 && zoned->zones[0].customers == 7 && zoned->zones[1].customers == 2 &&
+                     total_number_of_customers(zoned->zones[1].lanes[1]) == 1;
+    // 7 customers on 2 lanes against 2 on 3 is still too far apart, 6/2 against 3/3 is not.
+    if (escalated && balance_zoned_store(zoned) == 1 && zoned->zones[1].customers == 3 &&
+        balance_zoned_store(zoned) == 0 && !zoned->zones[0].dirty && !zoned->zones[1].dirty &&
+        process_all_zones(zoned) == 4 &&
+        zoned->zones[0].customers == 4 && zoned->zones[1].customers == 0) printf("R40 - Zoned Store Cross-Zone Escalation Case Passed.\n\n");
+    close_zoned_store(zoned);
+
     // RXX - close_store() All Cases
     close_store(lanes, 6);
     close_store(EmptyLanes, 3);
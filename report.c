@@ -0,0 +1,212 @@
+/**
+ * Buffered Receipt and Lane Reports
+ *
+ * Writes the same text as print_customer() and print_customers_in_lane() in
+ * main.c, byte for byte, but into one large reusable buffer with hand-rolled
+ * integer formatting. Nothing reaches the file descriptor until the buffer is
+ * full or report_flush() is called, and then it goes out with a single
+ * write() (repeated only if the kernel takes part of it or a signal
+ * interrupts it).
+ *
+ * If a write fails the error is printed once, the report is marked failed and
+ * everything from then on is dropped; report_flush() and report_free() return
+ * false so the caller can tell the output is incomplete.
+ *
+ * Reports write to the descriptor directly, bypassing stdio. Anything already
+ * printf()ed to stdout is flushed first so the two stay in order.
+ */
+#ifndef REPORT_C
+#define REPORT_C
+
+#include "wackystore.c"
+#include <errno.h>
+#include <unistd.h>
+
+#define REPORT_BUFFER_SIZE (4 * 1024 * 1024)
+
+// Longest single line we ever append: a full name plus an item count.
+#define REPORT_LINE_MAX (MAX_NAME_LENGTH + 32)
+
+typedef struct Report Report;
+struct Report {
+    int fd;
+    char* buffer;
+    size_t length;
+    size_t capacity;
+    bool failed;        // a write failed; output is being dropped
+};
+
+static const char report_digit_pairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+/**
+ * Function: report_init
+ * ---------------------
+ * Set up a report that writes to fd. The buffer is allocated once and reused
+ * across flushes.
+ */
+void report_init(Report* report, int fd) {
+    report->fd = fd;
+    report->buffer = (char*)malloc(REPORT_BUFFER_SIZE);
+    if (report->buffer == NULL) exit(1);
+    report->length = 0;
+    report->capacity = REPORT_BUFFER_SIZE;
+    report->failed = false;
+}
+
+/**
+ * Function: report_flush
+ * ----------------------
+ * Write everything buffered so far to the report's file descriptor. Return
+ * false if this or an earlier write failed.
+ */
+bool report_flush(Report* report) {
+    if (report->length == 0 || report->failed) {
+        report->length = 0;
+        return !report->failed;
+    }
+    if (report->fd == STDOUT_FILENO) fflush(stdout);
+
+    size_t written = 0;
+    while (written < report->length) {
+        ssize_t n = write(report->fd, report->buffer + written, report->length - written);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("report_flush");
+            report->failed = true;
+            break;
+        }
+        written += (size_t)n;
+    }
+    report->length = 0;
+    return !report->failed;
+}
+
+/**
+ * Function: report_free
+ * ---------------------
+ * Flush whatever is left and release the buffer. Return false if any write
+ * failed.
+ */
+bool report_free(Report* report) {
+    bool ok = report_flush(report);
+    free(report->buffer);
+    report->buffer = NULL;
+    report->capacity = 0;
+    return ok;
+}
+
+static inline void report_reserve(Report* report, size_t needed) {
+    if (report->capacity - report->length < needed) report_flush(report);
+}
+
+static inline void report_append(Report* report, const char* text, size_t length) {
+    memcpy(report->buffer + report->length, text, length);
+    report->length += length;
+}
+
+// Append text that may not fit in the buffer at all, a buffer's worth at a time.
+static void report_append_long(Report* report, const char* text, size_t length) {
+    while (length > 0) {
+        if (report->length == report->capacity) report_flush(report);
+        size_t chunk = report->capacity - report->length;
+        if (chunk > length) chunk = length;
+        report_append(report, text, chunk);
+        text += chunk;
+        length -= chunk;
+    }
+}
+
+/**
+ * Function: report_append_int
+ * ---------------------------
+ * Append value in decimal, the same way printf's "%d" would, two digits at a
+ * time from a lookup table.
+ */
+static inline void report_append_int(Report* report, int value) {
+    char digits[12];
+    char* end = digits + sizeof(digits);
+    char* p = end;
+    // Work in unsigned so INT_MIN does not overflow when negated.
+    unsigned int n = value < 0 ? 0u - (unsigned int)value : (unsigned int)value;
+
+    while (n >= 100) {
+        unsigned int pair = (n % 100) * 2;
+        n /= 100;
+        *--p = report_digit_pairs[pair + 1];
+        *--p = report_digit_pairs[pair];
+    }
+    if (n >= 10) {
+        *--p = report_digit_pairs[n * 2 + 1];
+        *--p = report_digit_pairs[n * 2];
+    } else {
+        *--p = (char)('0' + n);
+    }
+    if (value < 0) *--p = '-';
+    report_append(report, p, (size_t)(end - p));
+}
+
+/**
+ * Function: report_customer
+ * -------------------------
+ * Same output as print_customer(): the name, the cart total and one line per
+ * item, followed by a blank line.
+ */
+void report_customer(Report* report, Customer* customer) {
+    report_reserve(report, REPORT_LINE_MAX * 2);
+    report_append(report, "Customer: ", 10);
+    report_append(report, customer->name, (size_t)customer->name_length);
+    report_append(report, "\n  Cart [", 9);
+    report_append_int(report, total_number_of_items(customer));
+    report_append(report, "]:\n", 3);
+
+    ItemNode* head = customer->cart;
+    while (head != NULL) {
+        report_reserve(report, REPORT_LINE_MAX);
+        report_append(report, "    - ", 6);
+        report_append(report, head->name, strlen(head->name));
+        report_append(report, " x ", 3);
+        report_append_int(report, head->count);
+        report_append(report, "\n", 1);
+        head = head->next;
+    }
+
+    report_reserve(report, 1);
+    report_append(report, "\n", 1);
+}
+
+/**
+ * Function: report_lane
+ * ---------------------
+ * Same output as print_customers_in_lane(): the lane id, then every customer
+ * name from the front of the lane to the back. The lane id may be any length.
+ */
+void report_lane(Report* report, char lane_id[], CheckoutLane* lane) {
+    report_reserve(report, 5);
+    report_append(report, "Lane ", 5);
+    report_append_long(report, lane_id, strlen(lane_id));
+    report_reserve(report, 6);
+    report_append(report, ":\n\t-> ", 6);
+
+    CheckoutLaneNode* head = lane->first;
+    while (head != NULL) {
+        report_reserve(report, REPORT_LINE_MAX);
+        report_append(report, head->customer->name, (size_t)head->customer->name_length);
+        report_append(report, " ", 1);
+        head = head->back;
+    }
+
+    report_reserve(report, 1);
+    report_append(report, "\n", 1);
+}
+
+#endif
@@ -0,0 +1,483 @@
+/**
+ * Copy-on-Write Store Snapshots
+ *
+ * A store that reporting threads can read while cashiers and shoppers keep
+ * changing it, without either side waiting on the other.
+ *
+ * Nothing a reader can reach is ever modified in place:
+ *
+ *   - Lane membership lives in an immutable StoreVersion (one LaneVersion per
+ *     lane, each an array of Customer*). queue(), process() and balance build a
+ *     new StoreVersion that shares every untouched LaneVersion and publish it
+ *     with a single atomic store.
+ *   - A cart is an immutable sorted list of ItemNodes. Adding or removing an
+ *     item copies only the nodes in front of the change and shares the rest,
+ *     then publishes the new head in customer->cart with a single atomic store.
+ *
+ * A reader takes one consistent view of every lane with snap_read_begin(), and
+ * each cart it loads with snap_cart() is consistent in itself.
+ *
+ * Writers serialize among themselves on one mutex; readers never take it.
+ * Replaced versions, nodes and departed customers are retired rather than
+ * freed, and epoch-based reclamation frees them once no reader that might
+ * still see them is active.
+ */
+#ifndef SNAPSHOT_C
+#define SNAPSHOT_C
+
+#include "wackystore.c"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#define SNAP_MAX_READERS 64
+// Try to reclaim after this many retirements.
+#define SNAP_RECLAIM_BATCH 256
+
+#define SNAP_RETIRED_ITEM 0
+#define SNAP_RETIRED_CUSTOMER 1
+#define SNAP_RETIRED_VERSION 2
+
+typedef struct LaneVersion LaneVersion;
+struct LaneVersion {
+    int count;
+    Customer* customers[];   // front of the lane first
+};
+
+typedef struct StoreVersion StoreVersion;
+struct StoreVersion {
+    uint64_t version;
+    int number_of_lanes;
+    LaneVersion* lanes[];
+};
+
+typedef struct Retired Retired;
+struct Retired {
+    void* pointer;
+    int kind;
+    uint64_t epoch;
+    Retired* next;
+};
+
+typedef struct SnapStore SnapStore;
+struct SnapStore {
+    _Atomic(StoreVersion*) current;
+    pthread_mutex_t write_lock;
+
+    atomic_uint_fast64_t epoch;
+    atomic_uint_fast64_t reader_epochs[SNAP_MAX_READERS];   // 0 when idle
+    atomic_bool reader_taken[SNAP_MAX_READERS];
+
+    // Guarded by write_lock.
+    Retired* retired;
+    int retired_since_reclaim;
+};
+
+typedef struct SnapReader SnapReader;
+struct SnapReader {
+    SnapStore* store;
+    int slot;
+};
+
+static void snap_retire(SnapStore* store, void* pointer, int kind) {
+    Retired* r = (Retired*)malloc(sizeof(Retired));
+    if (r == NULL) exit(1);
+    r->pointer = pointer;
+    r->kind = kind;
+    r->epoch = atomic_load(&store->epoch);
+    r->next = store->retired;
+    store->retired = r;
+    store->retired_since_reclaim++;
+}
+
+static void snap_free_retired(Retired* r) {
+    if (r->kind == SNAP_RETIRED_ITEM) {
+        free(r->pointer);
+    } else if (r->kind == SNAP_RETIRED_CUSTOMER) {
+        free_customer((Customer*)r->pointer);
+    } else {
+        // A StoreVersion and any LaneVersions only it referenced are retired
+        // separately, so this frees exactly one block.
+        free(r->pointer);
+    }
+    free(r);
+}
+
+/**
+ * Function: snap_reclaim
+ * ----------------------
+ * Advance the epoch and free everything retired before the oldest epoch an
+ * active reader entered in. Must be called with write_lock held.
+ */
+static void snap_reclaim(SnapStore* store) {
+    uint64_t oldest = atomic_fetch_add(&store->epoch, 1) + 1;
+    for (int i = 0; i < SNAP_MAX_READERS; i++) {
+        uint64_t e = atomic_load(&store->reader_epochs[i]);
+        if (e != 0 && e < oldest) oldest = e;
+    }
+
+    Retired** link = &store->retired;
+    while (*link != NULL) {
+        Retired* r = *link;
+        if (r->epoch < oldest) {
+            *link = r->next;
+            snap_free_retired(r);
+        } else {
+            link = &r->next;
+        }
+    }
+    store->retired_since_reclaim = 0;
+}
+
+static void snap_maybe_reclaim(SnapStore* store) {
+    if (store->retired_since_reclaim >= SNAP_RECLAIM_BATCH) snap_reclaim(store);
+}
+
+static LaneVersion* lane_version_new(int count) {
+    LaneVersion* lane = (LaneVersion*)malloc(sizeof(LaneVersion) + (size_t)count * sizeof(Customer*));
+    if (lane == NULL) exit(1);
+    lane->count = count;
+    return lane;
+}
+
+/**
+ * Function: snap_begin_write
+ * --------------------------
+ * Take the write lock and return a private copy of the current StoreVersion
+ * (sharing every LaneVersion) for the caller to modify and publish.
+ */
+static StoreVersion* snap_begin_write(SnapStore* store) {
+    pthread_mutex_lock(&store->write_lock);
+    StoreVersion* current = atomic_load(&store->current);
+    size_t size = sizeof(StoreVersion) + (size_t)current->number_of_lanes * sizeof(LaneVersion*);
+    StoreVersion* next = (StoreVersion*)malloc(size);
+    if (next == NULL) exit(1);
+    memcpy(next, current, size);
+    next->version = current->version + 1;
+    return next;
+}
+
+/**
+ * Function: snap_publish
+ * ----------------------
+ * Make next the version readers see, retire the one it replaces along with
+ * every LaneVersion that is no longer shared, and release the write lock.
+ */
+static void snap_publish(SnapStore* store, StoreVersion* next) {
+    StoreVersion* previous = atomic_exchange(&store->current, next);
+    for (int i = 0; i < next->number_of_lanes; i++) {
+        if (previous->lanes[i] != next->lanes[i]) snap_retire(store, previous->lanes[i], SNAP_RETIRED_VERSION);
+    }
+    snap_retire(store, previous, SNAP_RETIRED_VERSION);
+    snap_maybe_reclaim(store);
+    pthread_mutex_unlock(&store->write_lock);
+}
+
+/**
+ * Function: snap_open_store
+ * -------------------------
+ * Open a store with the given number of empty lanes.
+ */
+SnapStore* snap_open_store(int number_of_lanes) {
+    SnapStore* store = (SnapStore*)calloc(1, sizeof(SnapStore));
+    StoreVersion* first = (StoreVersion*)calloc(1, sizeof(StoreVersion) +
+                                                   (size_t)number_of_lanes * sizeof(LaneVersion*));
+    if (store == NULL || first == NULL) exit(1);
+
+    first->number_of_lanes = number_of_lanes;
+    for (int i = 0; i < number_of_lanes; i++) {
+        first->lanes[i] = lane_version_new(0);
+    }
+    atomic_init(&store->current, first);
+    atomic_init(&store->epoch, 1);
+    pthread_mutex_init(&store->write_lock, NULL);
+    return store;
+}
+
+/**
+ * Function: snap_reader_init
+ * --------------------------
+ * Claim a reader slot. Each reporting thread needs its own SnapReader.
+ * Return false if all SNAP_MAX_READERS slots are taken.
+ */
+bool snap_reader_init(SnapReader* reader, SnapStore* store) {
+    for (int i = 0; i < SNAP_MAX_READERS; i++) {
+        bool expected = false;
+        if (atomic_compare_exchange_strong(&store->reader_taken[i], &expected, true)) {
+            reader->store = store;
+            reader->slot = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+void snap_reader_release(SnapReader* reader) {
+    atomic_store(&reader->store->reader_taken[reader->slot], false);
+}
+
+/**
+ * Function: snap_read_begin
+ * -------------------------
+ * Enter a read section and return the current StoreVersion. It, every
+ * Customer in it and every cart loaded with snap_cart() stay valid until
+ * snap_read_end().
+ */
+StoreVersion* snap_read_begin(SnapReader* reader) {
+    SnapStore* store = reader->store;
+    atomic_store(&store->reader_epochs[reader->slot], atomic_load(&store->epoch));
+    return atomic_load(&store->current);
+}
+
+void snap_read_end(SnapReader* reader) {
+    atomic_store(&reader->store->reader_epochs[reader->slot], 0);
+}
+
+/**
+ * Function: snap_cart
+ * -------------------
+ * Load the customer's current cart. The list it returns never changes.
+ */
+ItemNode* snap_cart(Customer* customer) {
+    return __atomic_load_n(&customer->cart, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * Function: snap_total_number_of_items
+ * ------------------------------------
+ * total_number_of_items() over one consistent version of the cart.
+ */
+int snap_total_number_of_items(Customer* customer) {
+    int counter = 0;
+    for (ItemNode* p = snap_cart(customer); p != NULL; p = p->next) {
+        counter += p->count;
+    }
+    return counter;
+}
+
+/**
+ * Function: snap_new_customer
+ * ---------------------------
+ * Allocate a customer for this store. Its cart may only be changed with
+ * snap_add_item() and snap_remove_item().
+ */
+Customer* snap_new_customer(char* name) {
+    return new_customer(name);
+}
+
+/**
+ * Function: snap_update_cart
+ * --------------------------
+ * Copy-on-write version of add_item_to_cart() (amount > 0) and
+ * remove_item_from_cart() (amount < 0, as a negative number).
+ *
+ * Nodes in front of the changed item are copied, the changed item gets a new
+ * node (or none, if its count drops to 0 or below), and everything behind it
+ * is shared with the old cart.
+ */
+static void snap_update_cart(SnapStore* store, Customer* customer, char* item_name, int delta) {
+    pthread_mutex_lock(&store->write_lock);
+    ItemNode* old_head = customer->cart;
+
+    // Find the first node not lexicographically smaller than item_name.
+    ItemNode* p = old_head;
+    int prefix = 0;
+    while (p != NULL && strcmp(p->name, item_name) < 0) {
+        p = p->next;
+        prefix++;
+    }
+    bool found = p != NULL && strcmp(p->name, item_name) == 0;
+    if (!found && delta < 0) {
+        pthread_mutex_unlock(&store->write_lock);
+        return;
+    }
+
+    // The shared tail and, if any, the replacement for the matched node.
+    ItemNode* tail = found ? p->next : p;
+    if (found && p->count + delta > 0) {
+        ItemNode* changed = new_item_node(p->name, p->count + delta);
+        changed->next = tail;
+        tail = changed;
+        customer->total_items += delta;
+    } else if (found) {
+        customer->total_items -= p->count;
+    } else {
+        ItemNode* added = new_item_node(item_name, delta);
+        added->next = tail;
+        tail = added;
+        customer->total_items += delta;
+    }
+
+    // Copy the prefix back to front so each copy can point at the next.
+    ItemNode** originals = (ItemNode**)malloc((size_t)(prefix + 1) * sizeof(ItemNode*));
+    if (originals == NULL) exit(1);
+    ItemNode* q = old_head;
+    for (int i = 0; i < prefix; i++, q = q->next) originals[i] = q;
+
+    ItemNode* head = tail;
+    for (int i = prefix - 1; i >= 0; i--) {
+        ItemNode* copy = new_item_node(originals[i]->name, originals[i]->count);
+        copy->next = head;
+        head = copy;
+    }
+    __atomic_store_n(&customer->cart, head, __ATOMIC_RELEASE);
+
+    for (int i = 0; i < prefix; i++) snap_retire(store, originals[i], SNAP_RETIRED_ITEM);
+    if (found) snap_retire(store, p, SNAP_RETIRED_ITEM);
+    free(originals);
+    snap_maybe_reclaim(store);
+    pthread_mutex_unlock(&store->write_lock);
+}
+
+/**
+ * Function: snap_add_item
+ * -----------------------
+ * add_item_to_cart() that never disturbs a reader walking the old cart.
+ */
+void snap_add_item(SnapStore* store, Customer* customer, char* item_name, int amount) {
+    if (customer == NULL || amount <= 0) return;
+    snap_update_cart(store, customer, item_name, amount);
+}
+
+/**
+ * Function: snap_remove_item
+ * --------------------------
+ * remove_item_from_cart() that never disturbs a reader walking the old cart.
+ */
+void snap_remove_item(SnapStore* store, Customer* customer, char* item_name, int amount) {
+    if (customer == NULL || amount <= 0) return;
+    snap_update_cart(store, customer, item_name, -amount);
+}
+
+/**
+ * Function: snap_queue
+ * --------------------
+ * queue() the customer at the end of lane number lane.
+ */
+void snap_queue(SnapStore* store, Customer* customer, int lane) {
+    if (customer == NULL) return;
+    StoreVersion* next = snap_begin_write(store);
+    if (lane < 0 || lane >= next->number_of_lanes) {
+        free(next);
+        pthread_mutex_unlock(&store->write_lock);
+        return;
+    }
+
+    LaneVersion* old_lane = next->lanes[lane];
+    LaneVersion* new_lane = lane_version_new(old_lane->count + 1);
+    memcpy(new_lane->customers, old_lane->customers, (size_t)old_lane->count * sizeof(Customer*));
+    new_lane->customers[old_lane->count] = customer;
+    next->lanes[lane] = new_lane;
+    snap_publish(store, next);
+}
+
+/**
+ * Function: snap_process
+ * ----------------------
+ * process() lane number lane: the customer at the front leaves and is freed
+ * once no reader can still see them. Return their number of items.
+ */
+int snap_process(SnapStore* store, int lane) {
+    StoreVersion* next = snap_begin_write(store);
+    if (lane < 0 || lane >= next->number_of_lanes || next->lanes[lane]->count == 0) {
+        free(next);
+        pthread_mutex_unlock(&store->write_lock);
+        return 0;
+    }
+
+    LaneVersion* old_lane = next->lanes[lane];
+    Customer* customer = old_lane->customers[0];
+    LaneVersion* new_lane = lane_version_new(old_lane->count - 1);
+    memcpy(new_lane->customers, old_lane->customers + 1, (size_t)new_lane->count * sizeof(Customer*));
+    next->lanes[lane] = new_lane;
+
+    int amount = total_number_of_items(customer);
+    snap_retire(store, customer, SNAP_RETIRED_CUSTOMER);
+    snap_publish(store, next);
+    return amount;
+}
+
+/**
+ * Function: snap_process_all_lanes
+ * --------------------------------
+ * process_all_lanes(), publishing a single new version for the whole round.
+ */
+int snap_process_all_lanes(SnapStore* store) {
+    StoreVersion* next = snap_begin_write(store);
+    int counter = 0;
+    for (int i = 0; i < next->number_of_lanes; i++) {
+        LaneVersion* old_lane = next->lanes[i];
+        if (old_lane->count == 0) continue;
+
+        Customer* customer = old_lane->customers[0];
+        LaneVersion* new_lane = lane_version_new(old_lane->count - 1);
+        memcpy(new_lane->customers, old_lane->customers + 1, (size_t)new_lane->count * sizeof(Customer*));
+        next->lanes[i] = new_lane;
+
+        counter += total_number_of_items(customer);
+        snap_retire(store, customer, SNAP_RETIRED_CUSTOMER);
+    }
+    snap_publish(store, next);
+    return counter;
+}
+
+/**
+ * Function: snap_balance_lanes
+ * ----------------------------
+ * balance_lanes() with the same rules: move the last customer of the first
+ * busiest lane to the end of the first least busy lane if they differ by more
+ * than one. Both lanes change in the same published version.
+ */
+bool snap_balance_lanes(SnapStore* store) {
+    StoreVersion* next = snap_begin_write(store);
+    int most = -1;
+    int least = -1;
+    for (int i = 0; i < next->number_of_lanes; i++) {
+        if (most == -1 || next->lanes[i]->count > next->lanes[most]->count) most = i;
+        if (least == -1 || next->lanes[i]->count < next->lanes[least]->count) least = i;
+    }
+    if (next->number_of_lanes < 2 || next->lanes[most]->count - next->lanes[least]->count <= 1) {
+        free(next);
+        pthread_mutex_unlock(&store->write_lock);
+        return false;
+    }
+
+    LaneVersion* from = next->lanes[most];
+    LaneVersion* to = next->lanes[least];
+    LaneVersion* new_from = lane_version_new(from->count - 1);
+    LaneVersion* new_to = lane_version_new(to->count + 1);
+    memcpy(new_from->customers, from->customers, (size_t)new_from->count * sizeof(Customer*));
+    memcpy(new_to->customers, to->customers, (size_t)to->count * sizeof(Customer*));
+    new_to->customers[to->count] = from->customers[from->count - 1];
+    next->lanes[most] = new_from;
+    next->lanes[least] = new_to;
+    snap_publish(store, next);
+    return true;
+}
+
+/**
+ * Function: snap_close_store
+ * --------------------------
+ * close_store(): free every lane, every customer still queued and everything
+ * still waiting to be reclaimed. No reader may be active.
+ */
+void snap_close_store(SnapStore* store) {
+    StoreVersion* current = atomic_load(&store->current);
+    for (int i = 0; i < current->number_of_lanes; i++) {
+        for (int j = 0; j < current->lanes[i]->count; j++) {
+            free_customer(current->lanes[i]->customers[j]);
+        }
+        free(current->lanes[i]);
+    }
+    free(current);
+
+    while (store->retired != NULL) {
+        Retired* r = store->retired;
+        store->retired = r->next;
+        snap_free_retired(r);
+    }
+    pthread_mutex_destroy(&store->write_lock);
+    free(store);
+}
+
+#endif
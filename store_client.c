@@ -0,0 +1,285 @@
+/**
+ * Wacky Store Load Generator
+ *
+ * Drives a running store_daemon with a synthetic workload from workload.c.
+ * Requests are sent in pipelined batches of exactly the batch size: the whole
+ * batch is written while replies are read back, and the next batch starts once
+ * every reply to the current one has arrived. A round of shopping that does
+ * not fit carries over into the next batch. A batch size of 1 gives the
+ * unpipelined round-trip latency for comparison.
+ *
+ * Reports throughput (requests per second) and the batch round-trip latency.
+ *
+ * Build: gcc -O2 store_client.c -o store_client -lm
+ * Usage: ./store_client [socket_path] [requests] [batch] [lanes] [seed]
+ */
+#include "workload.c"
+#include "store_protocol.h"
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct ClientStats ClientStats;
+struct ClientStats {
+    long requests;
+    long errors;
+    long items;
+    long moves;
+    double* latencies;
+    int batches;
+};
+
+static double now_seconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static int connect_to(char* path) {
+    struct sockaddr_un address;
+    if (strlen(path) >= sizeof(address.sun_path)) return -1;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int append_request(unsigned char* buffer, int op, int target, int amount, char* name) {
+    StoreRequest request;
+    request.op = (uint8_t)op;
+    request.length = name == NULL ? 0 : (uint16_t)strlen(name);
+    request.target = target;
+    request.amount = amount;
+    return store_encode_request(buffer, &request, name);
+}
+
+#define STREAM_ROUND 0
+#define STREAM_NEW 1
+#define STREAM_ADD 2
+#define STREAM_QUEUE 3
+#define STREAM_BALANCE 4
+#define STREAM_PROCESS 5
+
+// Where the client is in its rounds of shopping: each round is NEW, ADD... and
+// QUEUE for every arrival, then one BALANCE and one PROCESS_ALL.
+typedef struct RequestStream RequestStream;
+struct RequestStream {
+    Workload* workload;
+    int number_of_lanes;
+    int next_id;
+    int step;
+    int arriving;     // customers still to arrive this round
+    int id;           // customer being filled
+    int items_left;   // ADDs still to send for that customer
+};
+
+/**
+ * Function: stream_next
+ * ---------------------
+ * Append the next request of the stream to buffer and return its bytes.
+ */
+static int stream_next(RequestStream* stream, unsigned char* buffer) {
+    Workload* workload = stream->workload;
+    while (true) {
+        switch (stream->step) {
+            case STREAM_ROUND:
+                stream->arriving = workload_arrivals(workload);
+                stream->step = STREAM_NEW;
+                break;
+            case STREAM_NEW: {
+                if (stream->arriving == 0) {
+                    stream->step = STREAM_BALANCE;
+                    break;
+                }
+                stream->arriving--;
+                stream->id = stream->next_id;
+                stream->next_id = (stream->next_id + 1) % STORE_MAX_CUSTOMERS;
+                int length = append_request(buffer, STORE_OP_NEW, stream->id, 0,
+                                            workload_customer_name(workload));
+                stream->items_left = workload_cart_size(workload);
+                stream->step = STREAM_ADD;
+                return length;
+            }
+            case STREAM_ADD:
+                if (stream->items_left == 0) {
+                    stream->step = STREAM_QUEUE;
+                    break;
+                }
+                stream->items_left--;
+                return append_request(buffer, STORE_OP_ADD, stream->id, workload_amount(workload),
+                                      workload_item(workload));
+            case STREAM_QUEUE:
+                stream->step = STREAM_NEW;
+                return append_request(buffer, STORE_OP_QUEUE, stream->id,
+                                      workload_lane(workload, stream->number_of_lanes), NULL);
+            case STREAM_BALANCE:
+                stream->step = STREAM_PROCESS;
+                return append_request(buffer, STORE_OP_BALANCE, 0, 0, NULL);
+            default:
+                stream->step = STREAM_ROUND;
+                return append_request(buffer, STORE_OP_PROCESS_ALL, 0, 0, NULL);
+        }
+    }
+}
+
+/**
+ * Function: build_batch
+ * ---------------------
+ * Append the next count requests of the stream to buffer and return the bytes.
+ */
+static size_t build_batch(RequestStream* stream, unsigned char* buffer, int count) {
+    size_t length = 0;
+    for (int i = 0; i < count; i++) {
+        length += stream_next(stream, buffer + length);
+    }
+    return length;
+}
+
+/**
+ * Function: exchange
+ * ------------------
+ * Write length bytes of requests while reading back the expected number of
+ * replies, so neither side's socket buffer can fill up and stall the other.
+ * Return false if the daemon went away.
+ */
+static bool exchange(int fd, unsigned char* requests, size_t length, unsigned char* replies,
+                     int expected, ClientStats* stats) {
+    size_t sent = 0;
+    size_t received = 0;
+    size_t wanted = (size_t)expected * STORE_RESPONSE_SIZE;
+
+    while (received < wanted) {
+        struct pollfd pfd = {fd, POLLIN, 0};
+        if (sent < length) pfd.events |= POLLOUT;
+        if (poll(&pfd, 1, -1) < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if ((pfd.revents & POLLOUT) && sent < length) {
+            ssize_t n = send(fd, requests + sent, length - sent, MSG_DONTWAIT);
+            if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) return false;
+            if (n > 0) sent += (size_t)n;
+        }
+        if (pfd.revents & (POLLIN | POLLHUP | POLLERR)) {
+            ssize_t n = recv(fd, replies + received, wanted - received, MSG_DONTWAIT);
+            if (n == 0) return false;
+            if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) return false;
+            if (n > 0) received += (size_t)n;
+        }
+    }
+
+    for (int i = 0; i < expected; i++) {
+        StoreResponse response;
+        store_decode_response(replies + (size_t)i * STORE_RESPONSE_SIZE, &response);
+        if (response.status != STORE_OK) {
+            stats->errors++;
+        } else if (response.op == STORE_OP_PROCESS_ALL || response.op == STORE_OP_PROCESS) {
+            stats->items += response.value;
+        } else if (response.op == STORE_OP_BALANCE) {
+            stats->moves += response.value;
+        }
+    }
+    stats->requests += expected;
+    return true;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char* argv[]) {
+    char* path = argc > 1 ? argv[1] : STORE_DEFAULT_SOCKET;
+    long total_requests = argc > 2 ? atol(argv[2]) : 1000000;
+    int batch_size = argc > 3 ? atoi(argv[3]) : 4096;
+    int number_of_lanes = argc > 4 ? atoi(argv[4]) : 8;
+    uint64_t seed = argc > 5 ? strtoull(argv[5], NULL, 10) : 1;
+    if (total_requests < 1 || batch_size < 1 || number_of_lanes < 1 ||
+        number_of_lanes > STORE_MAX_LANES) {
+        fprintf(stderr, "usage: %s [socket_path] [requests] [batch] [lanes<=%d] [seed]\n",
+                argv[0], STORE_MAX_LANES);
+        return 1;
+    }
+
+    int fd = connect_to(path);
+    if (fd < 0) {
+        fprintf(stderr, "cannot connect to %s\n", path);
+        return 1;
+    }
+
+    WorkloadConfig config = workload_default_config();
+    WorkloadModel model;
+    if (!workload_model_init(&model, &config)) exit(1);
+    Workload workload;
+    workload_init(&workload, &model, seed);
+    RequestStream stream = {&workload, number_of_lanes, 0, STREAM_ROUND, 0, 0, 0};
+
+    // A name is at most 20 bytes, so this bounds a single request.
+    size_t capacity = (size_t)batch_size * (STORE_REQUEST_SIZE + 32);
+    unsigned char* requests = (unsigned char*)malloc(capacity);
+    unsigned char* replies = (unsigned char*)malloc((size_t)batch_size * STORE_RESPONSE_SIZE);
+    ClientStats stats = {0, 0, 0, 0, NULL, 0};
+    int latency_capacity = 1024;
+    stats.latencies = (double*)malloc((size_t)latency_capacity * sizeof(double));
+    if (requests == NULL || replies == NULL || stats.latencies == NULL) exit(1);
+
+    size_t length = append_request(requests, STORE_OP_OPEN, 0, number_of_lanes, NULL);
+    if (!exchange(fd, requests, length, replies, 1, &stats) || stats.errors > 0) {
+        fprintf(stderr, "daemon refused to open %d lanes\n", number_of_lanes);
+        return 1;
+    }
+    stats.requests = 0;
+
+    double start = now_seconds();
+    while (stats.requests < total_requests) {
+        int count = total_requests - stats.requests < batch_size ? (int)(total_requests - stats.requests)
+                                                                 : batch_size;
+        length = build_batch(&stream, requests, count);
+
+        double sent_at = now_seconds();
+        if (!exchange(fd, requests, length, replies, count, &stats)) {
+            fprintf(stderr, "lost connection to daemon\n");
+            return 1;
+        }
+        if (stats.batches == latency_capacity) {
+            latency_capacity *= 2;
+            stats.latencies = (double*)realloc(stats.latencies, (size_t)latency_capacity * sizeof(double));
+            if (stats.latencies == NULL) exit(1);
+        }
+        stats.latencies[stats.batches++] = now_seconds() - sent_at;
+    }
+    double elapsed = now_seconds() - start;
+    long sent = stats.requests;
+
+    length = append_request(requests, STORE_OP_CLOSE, 0, 0, NULL);
+    exchange(fd, requests, length, replies, 1, &stats);
+    close(fd);
+
+    qsort(stats.latencies, (size_t)stats.batches, sizeof(double), compare_doubles);
+    double p50 = stats.latencies[stats.batches / 2];
+    double p99 = stats.latencies[(int)(stats.batches * 0.99)];
+
+    printf("%ld requests in %d batches, %.3f s: %.0f requests/s\n", sent, stats.batches,
+           elapsed, sent / elapsed);
+    printf("batch round trip: p50 %.1f us, p99 %.1f us (%.0f ns per request at p50)\n",
+           p50 * 1e6, p99 * 1e6, p50 * 1e9 * stats.batches / sent);
+    printf("%ld items checked out, %ld balance moves, %ld errors\n", stats.items, stats.moves,
+           stats.errors);
+
+    free(requests);
+    free(replies);
+    free(stats.latencies);
+    workload_model_free(&model);
+    return stats.errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,375 @@
+/**
+ * Wacky Store Daemon
+ *
+ * Keeps a store's lanes alive in one long-running process and serves the
+ * binary protocol from store_protocol.h over a Unix domain socket.
+ *
+ * The daemon is a single-threaded poll() loop, so the store itself needs no
+ * locking. Each connection reads as much as the socket has, runs every
+ * complete request in the buffer, and sends all of the replies back with one
+ * write(). Clients can therefore pipeline and batch freely; a connection
+ * that stops reading its replies is simply not read from until it catches up.
+ *
+ * Build: gcc -O2 store_daemon.c -o store_daemon
+ * Usage: ./store_daemon [socket_path]
+ */
+#include "wackystore.c"
+#include "store_protocol.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define DAEMON_MAX_CONNECTIONS 64
+#define DAEMON_IN_CAPACITY (256 * 1024)
+#define DAEMON_OUT_CAPACITY (512 * 1024)
+// Stop reading from a connection while this many reply bytes are unsent.
+#define DAEMON_OUT_HIGH_WATER (256 * 1024)
+
+typedef struct Store Store;
+struct Store {
+    CheckoutLane** lanes;
+    int number_of_lanes;
+    Customer** customers;   // customers still shopping, by client-chosen id
+};
+
+typedef struct Connection Connection;
+struct Connection {
+    int fd;
+    unsigned char* in;
+    size_t in_length;
+    unsigned char* out;
+    size_t out_length;
+    size_t out_sent;
+};
+
+static volatile sig_atomic_t stopping = 0;
+
+static void on_signal(int signal_number) {
+    (void)signal_number;
+    stopping = 1;
+}
+
+/**
+ * Function: store_close
+ * ---------------------
+ * Close the lanes (freeing anyone still queued) and free every customer that
+ * was still shopping.
+ */
+static void store_close(Store* store) {
+    if (store->lanes != NULL) {
+        close_store(store->lanes, store->number_of_lanes);
+        free(store->lanes);
+        store->lanes = NULL;
+        store->number_of_lanes = 0;
+    }
+    for (int i = 0; i < STORE_MAX_CUSTOMERS; i++) {
+        if (store->customers[i] != NULL) {
+            free_customer(store->customers[i]);
+            store->customers[i] = NULL;
+        }
+    }
+}
+
+static bool valid_customer(Store* store, int32_t id) {
+    return id >= 0 && id < STORE_MAX_CUSTOMERS && store->customers[id] != NULL;
+}
+
+/**
+ * Function: store_execute
+ * -----------------------
+ * Run a single decoded request against the store and fill in the response.
+ * name points at request->length bytes that are not NUL-terminated.
+ */
+static void store_execute(Store* store, StoreRequest* request, const unsigned char* name,
+                          StoreResponse* response) {
+    char buffer[MAX_NAME_LENGTH];
+    response->op = request->op;
+    response->status = STORE_OK;
+    response->value = 0;
+
+    if (request->length >= MAX_NAME_LENGTH) {
+        response->status = STORE_ERR_NAME;
+        return;
+    }
+    memcpy(buffer, name, request->length);
+    buffer[request->length] = '\0';
+
+    switch (request->op) {
+    case STORE_OP_OPEN:
+        if (request->amount < 1 || request->amount > STORE_MAX_LANES) {
+            response->status = STORE_ERR_LANE;
+            return;
+        }
+        store_close(store);
+        store->lanes = (CheckoutLane**)calloc((size_t)request->amount, sizeof(CheckoutLane*));
+        if (store->lanes == NULL) exit(1);
+        for (int i = 0; i < request->amount; i++) {
+            store->lanes[i] = open_new_checkout_line();
+        }
+        store->number_of_lanes = request->amount;
+        response->value = request->amount;
+        return;
+
+    case STORE_OP_NEW:
+        if (request->target < 0 || request->target >= STORE_MAX_CUSTOMERS ||
+            store->customers[request->target] != NULL) {
+            response->status = STORE_ERR_CUSTOMER;
+            return;
+        }
+        store->customers[request->target] = new_customer(buffer);
+        return;
+
+    case STORE_OP_ADD:
+    case STORE_OP_REMOVE:
+        if (!valid_customer(store, request->target)) {
+            response->status = STORE_ERR_CUSTOMER;
+            return;
+        }
+        if (request->op == STORE_OP_ADD) {
+            add_item_to_cart(store->customers[request->target], buffer, request->amount);
+        } else {
+            remove_item_from_cart(store->customers[request->target], buffer, request->amount);
+        }
+        response->value = total_number_of_items(store->customers[request->target]);
+        return;
+
+    case STORE_OP_CLOSE:
+        store_close(store);
+        return;
+
+    default:
+        break;
+    }
+
+    // Everything below needs an open store.
+    if (store->lanes == NULL) {
+        response->status = (request->op >= STORE_OP_QUEUE && request->op <= STORE_OP_BALANCE)
+                               ? STORE_ERR_NO_STORE : STORE_ERR_OP;
+        return;
+    }
+
+    switch (request->op) {
+    case STORE_OP_QUEUE:
+        if (!valid_customer(store, request->target)) {
+            response->status = STORE_ERR_CUSTOMER;
+            return;
+        }
+        if (request->amount < 0 || request->amount >= store->number_of_lanes) {
+            response->status = STORE_ERR_LANE;
+            return;
+        }
+        queue(store->customers[request->target], store->lanes[request->amount]);
+        store->customers[request->target] = NULL;
+        return;
+
+    case STORE_OP_PROCESS:
+        if (request->target < 0 || request->target >= store->number_of_lanes) {
+            response->status = STORE_ERR_LANE;
+            return;
+        }
+        response->value = process(store->lanes[request->target]);
+        return;
+
+    case STORE_OP_PROCESS_ALL:
+        response->value = process_all_lanes(store->lanes, store->number_of_lanes);
+        return;
+
+    case STORE_OP_BALANCE:
+        response->value = balance_lanes(store->lanes, store->number_of_lanes);
+        return;
+
+    default:
+        response->status = STORE_ERR_OP;
+        return;
+    }
+}
+
+/**
+ * Function: connection_serve
+ * --------------------------
+ * Execute every complete request waiting in the input buffer, for as long as
+ * there is room for the replies, and shift any partial request to the front.
+ */
+static void connection_serve(Connection* connection, Store* store) {
+    size_t offset = 0;
+    while (connection->in_length - offset >= STORE_REQUEST_SIZE &&
+           DAEMON_OUT_CAPACITY - connection->out_length >= STORE_RESPONSE_SIZE) {
+        StoreRequest request;
+        store_decode_request(connection->in + offset, &request);
+        if (connection->in_length - offset < (size_t)STORE_REQUEST_SIZE + request.length) break;
+
+        StoreResponse response;
+        store_execute(store, &request, connection->in + offset + STORE_REQUEST_SIZE, &response);
+        store_encode_response(connection->out + connection->out_length, &response);
+        connection->out_length += STORE_RESPONSE_SIZE;
+        offset += STORE_REQUEST_SIZE + request.length;
+    }
+    if (offset > 0) {
+        memmove(connection->in, connection->in + offset, connection->in_length - offset);
+        connection->in_length -= offset;
+    }
+}
+
+/**
+ * Function: connection_flush
+ * --------------------------
+ * Send as much of the pending reply data as the socket takes without blocking.
+ * Return false if the connection failed.
+ */
+static bool connection_flush(Connection* connection) {
+    while (connection->out_sent < connection->out_length) {
+        ssize_t n = write(connection->fd, connection->out + connection->out_sent,
+                          connection->out_length - connection->out_sent);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return true;
+            if (errno == EINTR) continue;
+            return false;
+        }
+        connection->out_sent += (size_t)n;
+    }
+    connection->out_length = 0;
+    connection->out_sent = 0;
+    return true;
+}
+
+/**
+ * Function: connection_read
+ * -------------------------
+ * Read whatever has arrived, serve it and flush the replies. Return false if
+ * the client hung up or the connection failed.
+ */
+static bool connection_read(Connection* connection, Store* store) {
+    ssize_t n = read(connection->fd, connection->in + connection->in_length,
+                     DAEMON_IN_CAPACITY - connection->in_length);
+    if (n == 0) return false;
+    if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    connection->in_length += (size_t)n;
+
+    connection_serve(connection, store);
+    return connection_flush(connection);
+}
+
+static void connection_free(Connection* connection) {
+    close(connection->fd);
+    free(connection->in);
+    free(connection->out);
+    free(connection);
+}
+
+static int listen_on(char* path) {
+    struct sockaddr_un address;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "socket path too long: %s\n", path);
+        return -1;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    unlink(path);
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) < 0 || listen(fd, 16) < 0) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    return fd;
+}
+
+int main(int argc, char* argv[]) {
+    char* path = argc > 1 ? argv[1] : STORE_DEFAULT_SOCKET;
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    int listen_fd = listen_on(path);
+    if (listen_fd < 0) return 1;
+
+    Store store = {NULL, 0, NULL};
+    store.customers = (Customer**)calloc(STORE_MAX_CUSTOMERS, sizeof(Customer*));
+    if (store.customers == NULL) exit(1);
+
+    Connection* connections[DAEMON_MAX_CONNECTIONS];
+    int number_of_connections = 0;
+    struct pollfd fds[DAEMON_MAX_CONNECTIONS + 1];
+
+    printf("Wacky Store daemon listening on %s\n", path);
+    fflush(stdout);
+
+    while (!stopping) {
+        fds[0].fd = listen_fd;
+        fds[0].events = number_of_connections < DAEMON_MAX_CONNECTIONS ? POLLIN : 0;
+        for (int i = 0; i < number_of_connections; i++) {
+            Connection* connection = connections[i];
+            fds[i + 1].fd = connection->fd;
+            fds[i + 1].events = 0;
+            if (connection->out_length - connection->out_sent < DAEMON_OUT_HIGH_WATER &&
+                connection->in_length < DAEMON_IN_CAPACITY) {
+                fds[i + 1].events |= POLLIN;
+            }
+            if (connection->out_sent < connection->out_length) fds[i + 1].events |= POLLOUT;
+        }
+
+        if (poll(fds, (nfds_t)number_of_connections + 1, -1) < 0) {
+            if (errno == EINTR) continue;
+            perror("poll");
+            break;
+        }
+
+        // Walk backwards so a closed connection can be swapped with the last one.
+        for (int i = number_of_connections - 1; i >= 0; i--) {
+            Connection* connection = connections[i];
+            short revents = fds[i + 1].revents;
+            bool alive = true;
+
+            if (revents & POLLOUT) {
+                alive = connection_flush(connection);
+                // Replies drained: requests left waiting on buffer space can run.
+                if (alive && connection->in_length > 0) {
+                    connection_serve(connection, &store);
+                    alive = connection_flush(connection);
+                }
+            }
+            if (alive && (revents & POLLIN)) alive = connection_read(connection, &store);
+            if (alive && (revents & (POLLERR | POLLHUP)) && !(revents & POLLIN)) alive = false;
+
+            if (!alive) {
+                connection_free(connection);
+                connections[i] = connections[--number_of_connections];
+            }
+        }
+
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(listen_fd, NULL, NULL);
+            if (fd >= 0) {
+                fcntl(fd, F_SETFL, O_NONBLOCK);
+                Connection* connection = (Connection*)calloc(1, sizeof(Connection));
+                if (connection == NULL) exit(1);
+                connection->fd = fd;
+                connection->in = (unsigned char*)malloc(DAEMON_IN_CAPACITY);
+                connection->out = (unsigned char*)malloc(DAEMON_OUT_CAPACITY);
+                if (connection->in == NULL || connection->out == NULL) exit(1);
+                connections[number_of_connections++] = connection;
+            }
+        }
+    }
+
+    for (int i = 0; i < number_of_connections; i++) {
+        connection_free(connections[i]);
+    }
+    store_close(&store);
+    free(store.customers);
+    close(listen_fd);
+    unlink(path);
+    return 0;
+}
@@ -0,0 +1,102 @@
+/**
+ * Wacky Store Daemon Protocol
+ *
+ * Binary protocol spoken over the daemon's Unix domain socket. Both ends run
+ * on the same machine, so integers are sent in host byte order.
+ *
+ * Every request is a fixed 12-byte header followed by `length` bytes of name
+ * (a customer name for STORE_OP_NEW, an item name for STORE_OP_ADD and
+ * STORE_OP_REMOVE, nothing otherwise). Names are not NUL-terminated.
+ *
+ * Every request gets exactly one fixed 8-byte response, in request order, so a
+ * client may pipeline as many requests as it likes before reading replies.
+ *
+ * Customers are named by a client-chosen id in [0, STORE_MAX_CUSTOMERS). The
+ * id is taken by STORE_OP_NEW and handed back by STORE_OP_QUEUE, when the
+ * customer leaves the client's hands and joins a lane. Because the client picks
+ * the id, a NEW/ADD/QUEUE sequence can be sent without waiting for replies.
+ */
+#ifndef STORE_PROTOCOL_H
+#define STORE_PROTOCOL_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define STORE_DEFAULT_SOCKET "/tmp/wackystore.sock"
+#define STORE_MAX_CUSTOMERS (1 << 20)
+#define STORE_MAX_LANES 4096
+#define STORE_REQUEST_SIZE 12
+#define STORE_RESPONSE_SIZE 8
+
+// Requests. "target" and "amount" are the two 32-bit header fields.
+#define STORE_OP_OPEN 1         // close any open store, open `amount` lanes
+#define STORE_OP_NEW 2          // new_customer(name) as id `target`
+#define STORE_OP_ADD 3          // add_item_to_cart(target, name, amount)
+#define STORE_OP_REMOVE 4       // remove_item_from_cart(target, name, amount)
+#define STORE_OP_QUEUE 5        // queue(target, lanes[amount]) and release the id
+#define STORE_OP_PROCESS 6      // process(lanes[target]), value = items
+#define STORE_OP_PROCESS_ALL 7  // process_all_lanes(), value = items
+#define STORE_OP_BALANCE 8      // balance_lanes(), value = 1 if a customer moved
+#define STORE_OP_CLOSE 9        // close_store() and free customers not yet queued
+
+// Response status codes.
+#define STORE_OK 0
+#define STORE_ERR_OP 1          // unknown op
+#define STORE_ERR_NO_STORE 2    // lane op with no store open
+#define STORE_ERR_LANE 3        // lane index out of range
+#define STORE_ERR_CUSTOMER 4    // id out of range, or not (or already) in use
+#define STORE_ERR_NAME 5        // name too long
+
+typedef struct StoreRequest StoreRequest;
+struct StoreRequest {
+    uint8_t op;
+    uint16_t length;
+    int32_t target;
+    int32_t amount;
+};
+
+typedef struct StoreResponse StoreResponse;
+struct StoreResponse {
+    uint8_t op;
+    uint8_t status;
+    int32_t value;
+};
+
+/**
+ * Function: store_encode_request
+ * ------------------------------
+ * Write the request header followed by the name into buffer, which must have
+ * room for STORE_REQUEST_SIZE + request->length bytes. Return the bytes written.
+ */
+static inline int store_encode_request(unsigned char* buffer, StoreRequest* request, const char* name) {
+    buffer[0] = request->op;
+    buffer[1] = 0;
+    memcpy(buffer + 2, &request->length, 2);
+    memcpy(buffer + 4, &request->target, 4);
+    memcpy(buffer + 8, &request->amount, 4);
+    if (name != NULL && request->length > 0) memcpy(buffer + STORE_REQUEST_SIZE, name, request->length);
+    return STORE_REQUEST_SIZE + request->length;
+}
+
+static inline void store_decode_request(const unsigned char* buffer, StoreRequest* request) {
+    request->op = buffer[0];
+    memcpy(&request->length, buffer + 2, 2);
+    memcpy(&request->target, buffer + 4, 4);
+    memcpy(&request->amount, buffer + 8, 4);
+}
+
+static inline void store_encode_response(unsigned char* buffer, StoreResponse* response) {
+    buffer[0] = response->op;
+    buffer[1] = response->status;
+    buffer[2] = 0;
+    buffer[3] = 0;
+    memcpy(buffer + 4, &response->value, 4);
+}
+
+static inline void store_decode_response(const unsigned char* buffer, StoreResponse* response) {
+    response->op = buffer[0];
+    response->status = buffer[1];
+    memcpy(&response->value, buffer + 4, 4);
+}
+
+#endif
@@ -0,0 +1,316 @@
+/**
+ * Store Activity Tracer
+ *
+ * Records begin/end events for process(), balance_lanes(), process_all_lanes()
+ * and close_store(), plus an instant event for each queue(), and exports them
+ * as a Chrome trace JSON file that opens in Perfetto (ui.perfetto.dev) or
+ * chrome://tracing. Lanes with nobody to serve and balance_lanes() calls that
+ * move nobody are left out, since they only add empty slices.
+ *
+ * Tracing is compiled in only when WACKY_TRACE is defined; wackystore.c then
+ * includes this file and its TRACE_* hooks become calls. Otherwise the hooks
+ * expand to nothing and cost nothing.
+ *
+ *   gcc -O2 -pthread -DWACKY_TRACE batch.c -o batch -lm
+ *
+ * Each thread writes into its own ring buffer of TRACE_BUFFER_EVENTS events,
+ * so recording takes no lock and no allocation after the thread's first
+ * event. When a ring fills up the oldest events are overwritten. A thread's
+ * buffer goes back to a free list when the thread exits and is handed to the
+ * next new thread, which carries on in the same ring and on the same track of
+ * the timeline. So short-lived worker threads do not use up the
+ * TRACE_MAX_THREADS buffers; past that many live threads, the extra threads
+ * are not traced and a warning is printed once. Call trace_export() once the
+ * traced threads have finished (or are idle).
+ *
+ * On x86 events are stamped with the time-stamp counter, which costs less than
+ * clock_gettime(), and trace_export() converts counter ticks to
+ * nanoseconds against CLOCK_MONOTONIC.
+ *
+ * Event arguments: "lane" and "customer" are ids the tracer hands out as
+ * lanes are opened and customers are made (CheckoutLane.id, Customer.id), so
+ * they stay the same for the lane's or customer's whole life and are never
+ * reused, even when a recycled Customer block is. Lane ids count up from 1 in
+ * the order lanes are opened. Customer ids are handed to each thread in blocks
+ * of TRACE_ID_BLOCK, so they are unique but only ordered within a thread.
+ */
+#ifndef TRACE_C
+#define TRACE_C
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#ifndef TRACE_BUFFER_EVENTS
+#define TRACE_BUFFER_EVENTS (1 << 16)   // must be a power of two
+#endif
+#define TRACE_MAX_THREADS 256
+#define TRACE_ID_BLOCK 1024
+
+typedef struct TraceEvent TraceEvent;
+struct TraceEvent {
+    uint64_t timestamp;      // trace_ticks()
+    const char* name;
+    unsigned int customer;   // Customer.id, 0 for none
+    unsigned int lane;       // CheckoutLane.id, 0 for none
+    char phase;              // 'B', 'E' or 'i' (instant)
+};
+
+typedef struct TraceBuffer TraceBuffer;
+struct TraceBuffer {
+    atomic_uint_fast64_t head;   // number of events ever written
+    int thread;
+    TraceEvent events[TRACE_BUFFER_EVENTS];
+};
+
+static atomic_bool trace_enabled = true;
+static atomic_uint trace_lane_count = 0;
+static atomic_uint trace_customer_blocks = 0;
+static _Thread_local unsigned int trace_customer_next = 0;
+static _Thread_local unsigned int trace_customer_end = 0;
+static TraceBuffer* trace_buffers[TRACE_MAX_THREADS];
+static atomic_int trace_thread_count = 0;   // buffers allocated so far
+static _Thread_local TraceBuffer* trace_local = NULL;
+static _Thread_local bool trace_untraced = false;
+
+// Guards the free list and buffer allocation; taken once per thread.
+static pthread_mutex_t trace_threads_lock = PTHREAD_MUTEX_INITIALIZER;
+static int trace_free_slots[TRACE_MAX_THREADS];
+static int trace_free_count = 0;
+static pthread_once_t trace_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t trace_key;
+
+// Clock reading and tick count taken together when tracing starts.
+static uint64_t trace_base_ticks;
+static uint64_t trace_base_ns;
+
+static uint64_t trace_clock_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+static inline uint64_t trace_ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return trace_clock_ns();
+#endif
+}
+
+/**
+ * Function: trace_set_enabled
+ * ---------------------------
+ * Switch recording on or off at run time. Tracing starts enabled.
+ */
+void trace_set_enabled(bool enabled) {
+    atomic_store_explicit(&trace_enabled, enabled, memory_order_relaxed);
+}
+
+/**
+ * Function: trace_lane_id
+ * -----------------------
+ * Return the id for a newly opened lane.
+ */
+unsigned int trace_lane_id() {
+    return atomic_fetch_add_explicit(&trace_lane_count, 1, memory_order_relaxed) + 1;
+}
+
+/**
+ * Function: trace_customer_id
+ * ---------------------------
+ * Return the id for a new customer, taking a fresh block of ids for the
+ * calling thread when its current one runs out.
+ */
+unsigned int trace_customer_id() {
+    if (trace_customer_next == trace_customer_end) {
+        unsigned int block = atomic_fetch_add_explicit(&trace_customer_blocks, 1, memory_order_relaxed);
+        trace_customer_next = block * TRACE_ID_BLOCK + 1;
+        trace_customer_end = trace_customer_next + TRACE_ID_BLOCK;
+    }
+    return trace_customer_next++;
+}
+
+static void trace_thread_exit(void* buffer) {
+    pthread_mutex_lock(&trace_threads_lock);
+    trace_free_slots[trace_free_count++] = ((TraceBuffer*)buffer)->thread;
+    pthread_mutex_unlock(&trace_threads_lock);
+}
+
+static void trace_create_key() {
+    if (pthread_key_create(&trace_key, trace_thread_exit) != 0) exit(1);
+    trace_base_ns = trace_clock_ns();
+    trace_base_ticks = trace_ticks();
+}
+
+/**
+ * Function: trace_register_thread
+ * -------------------------------
+ * Give the calling thread a buffer: one left by a thread that has exited if
+ * there is one, otherwise a new one. Return NULL once every buffer is taken.
+ */
+static TraceBuffer* trace_register_thread() {
+    pthread_once(&trace_key_once, trace_create_key);
+
+    TraceBuffer* buffer = NULL;
+    pthread_mutex_lock(&trace_threads_lock);
+    if (trace_free_count > 0) {
+        buffer = trace_buffers[trace_free_slots[--trace_free_count]];
+    } else {
+        int thread = atomic_load(&trace_thread_count);
+        if (thread < TRACE_MAX_THREADS) {
+            buffer = (TraceBuffer*)calloc(1, sizeof(TraceBuffer));
+            if (buffer == NULL) exit(1);
+            buffer->thread = thread;
+            trace_buffers[thread] = buffer;
+            atomic_store(&trace_thread_count, thread + 1);
+        } else if (thread == TRACE_MAX_THREADS) {
+            fprintf(stderr, "trace: more than %d live threads, not tracing the rest\n", TRACE_MAX_THREADS);
+            atomic_store(&trace_thread_count, thread + 1);
+        }
+    }
+    pthread_mutex_unlock(&trace_threads_lock);
+
+    if (buffer != NULL) pthread_setspecific(trace_key, buffer);
+    return buffer;
+}
+
+/**
+ * Function: trace_record
+ * ----------------------
+ * Append one event to the calling thread's ring buffer.
+ */
+void trace_record(char phase, const char* name, unsigned int lane, unsigned int customer) {
+    if (!atomic_load_explicit(&trace_enabled, memory_order_relaxed)) return;
+    if (trace_local == NULL) {
+        if (trace_untraced) return;
+        trace_local = trace_register_thread();
+        if (trace_local == NULL) {
+            trace_untraced = true;
+            return;
+        }
+    }
+
+    uint64_t head = atomic_load_explicit(&trace_local->head, memory_order_relaxed);
+    TraceEvent* event = &trace_local->events[head & (TRACE_BUFFER_EVENTS - 1)];
+    event->timestamp = trace_ticks();
+    event->name = name;
+    event->customer = customer;
+    event->lane = lane;
+    event->phase = phase;
+    // Publish the event to trace_export() only once it is fully written.
+    atomic_store_explicit(&trace_local->head, head + 1, memory_order_release);
+}
+
+/**
+ * Function: trace_cancel
+ * ----------------------
+ * Drop the calling thread's most recent event, for a TRACE_BEGIN() that
+ * turned out to be a no-op. Only valid while nothing else has been recorded
+ * on this thread since that TRACE_BEGIN().
+ */
+void trace_cancel() {
+    if (trace_local == NULL || !atomic_load_explicit(&trace_enabled, memory_order_relaxed)) return;
+    uint64_t head = atomic_load_explicit(&trace_local->head, memory_order_relaxed);
+    if (head > 0) atomic_store_explicit(&trace_local->head, head - 1, memory_order_release);
+}
+
+#define TRACE_BEGIN(name, lane_id, customer_id) trace_record('B', (name), (lane_id), (customer_id))
+#define TRACE_END(name, lane_id, customer_id) trace_record('E', (name), (lane_id), (customer_id))
+#define TRACE_INSTANT(name, lane_id, customer_id) trace_record('i', (name), (lane_id), (customer_id))
+#define TRACE_CANCEL() trace_cancel()
+#define TRACE_LANE_ID() trace_lane_id()
+#define TRACE_CUSTOMER_ID() trace_customer_id()
+
+static char* trace_put(char* out, const char* text) {
+    while (*text != '\0') *out++ = *text++;
+    return out;
+}
+
+// Write value in the given base, zero-padded to at least width digits.
+static char* trace_put_number(char* out, uint64_t value, unsigned base, int width) {
+    char digits[24];
+    int n = 0;
+    do {
+        digits[n++] = "0123456789abcdef"[value % base];
+        value /= base;
+    } while (value != 0 || n < width);
+    while (n > 0) *out++ = digits[--n];
+    return out;
+}
+
+/**
+ * Function: trace_export
+ * ----------------------
+ * Write every buffered event of every thread to path in Chrome trace JSON.
+ * Return false if the file could not be written.
+ */
+bool trace_export(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        perror(path);
+        return false;
+    }
+
+    // Scale ticks to nanoseconds by how far both have moved since tracing began.
+    uint64_t elapsed_ticks = trace_ticks() - trace_base_ticks;
+    uint64_t elapsed_ns = trace_clock_ns() - trace_base_ns;
+    double ns_per_tick = elapsed_ticks > 0 ? (double)elapsed_ns / (double)elapsed_ticks : 1.0;
+
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    bool first = true;
+    int threads = atomic_load(&trace_thread_count);
+    if (threads > TRACE_MAX_THREADS) threads = TRACE_MAX_THREADS;
+
+    for (int t = 0; t < threads; t++) {
+        TraceBuffer* buffer = trace_buffers[t];
+        if (buffer == NULL) continue;
+        uint64_t head = atomic_load_explicit(&buffer->head, memory_order_acquire);
+        uint64_t start = head > TRACE_BUFFER_EVENTS ? head - TRACE_BUFFER_EVENTS : 0;
+
+        for (uint64_t i = start; i < head; i++) {
+            TraceEvent* event = &buffer->events[i & (TRACE_BUFFER_EVENTS - 1)];
+            uint64_t timestamp = trace_base_ns + (uint64_t)((double)(event->timestamp - trace_base_ticks) * ns_per_tick);
+            char line[256];
+            char* out = line;
+            out = trace_put(out, first ? "{\"name\":\"" : ",\n{\"name\":\"");
+            out = trace_put(out, event->name);
+            out = trace_put(out, "\",\"ph\":\"");
+            *out++ = event->phase;
+            // Instant events are drawn on their thread's track.
+            out = trace_put(out, event->phase == 'i' ? "\",\"s\":\"t\",\"pid\":1,\"tid\":" : "\",\"pid\":1,\"tid\":");
+            out = trace_put_number(out, (uint64_t)buffer->thread, 10, 1);
+            out = trace_put(out, ",\"ts\":");
+            out = trace_put_number(out, timestamp / 1000, 10, 1);
+            *out++ = '.';
+            out = trace_put_number(out, timestamp % 1000, 10, 3);
+            if (event->lane != 0 || event->customer != 0) {
+                out = trace_put(out, ",\"args\":{");
+                if (event->lane != 0) {
+                    out = trace_put(out, "\"lane\":");
+                    out = trace_put_number(out, event->lane, 10, 1);
+                }
+                if (event->customer != 0) {
+                    out = trace_put(out, event->lane != 0 ? ",\"customer\":" : "\"customer\":");
+                    out = trace_put_number(out, event->customer, 10, 1);
+                }
+                *out++ = '}';
+            }
+            *out++ = '}';
+            fwrite(line, 1, (size_t)(out - line), file);
+            first = false;
+        }
+    }
+
+    fprintf(file, "\n]}\n");
+    return fclose(file) == 0;
+}
+
+#endif
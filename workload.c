@@ -0,0 +1,393 @@
+/**
+ * Synthetic Workload Generator
+ *
+ * Produces deterministic, seeded streams of shoppers for driving the Wacky
+ * Store at high volume:
+ *
+ *   - item popularity follows a Zipf distribution over a fixed catalog,
+ *   - cart sizes follow a configurable fixed, uniform or geometric distribution,
+ *   - arrivals per round are Poisson, switching between a calm rate and a
+ *     burst rate (a two-state Markov chain),
+ *   - customer and item names come from pools built up front.
+ *
+ * A WorkloadModel holds every table and is built once; it is read-only after
+ * workload_model_init() and can be shared by any number of threads. Each
+ * Workload stream only holds its RNG and burst state, so drawing from it never
+ * allocates. All discrete distributions use Vose alias tables, so each draw is
+ * O(1) no matter how large the catalog is.
+ *
+ * Link with -lm (the tables are built with pow() and exp()).
+ */
+#include "wackystore.c"
+#include <stdint.h>
+
+#define WORKLOAD_CART_FIXED 0
+#define WORKLOAD_CART_UNIFORM 1
+#define WORKLOAD_CART_GEOMETRIC 2
+
+#define WORKLOAD_MAX_RATE 500.0
+
+typedef struct WorkloadConfig WorkloadConfig;
+struct WorkloadConfig {
+    int catalog_size;       // number of distinct item names
+    double zipf_exponent;   // popularity skew, 0 is uniform
+    int cart_distribution;  // WORKLOAD_CART_*
+    int cart_min;           // smallest cart (uniform) or the only size (fixed)
+    int cart_max;           // largest cart; geometric draws are cut off here
+    double cart_mean;       // mean cart size for the geometric distribution
+    int max_amount;         // each add_item_to_cart() asks for 1..max_amount
+    double calm_rate;       // mean arrivals per round outside a burst
+    double burst_rate;      // mean arrivals per round during a burst
+    double burst_start;     // chance per round that a calm period turns bursty
+    double burst_end;       // chance per round that a burst calms down
+    int name_pool_size;     // number of distinct customer names
+};
+
+/**
+ * Alias table for sampling from a discrete distribution over 0..size-1.
+ */
+typedef struct AliasTable AliasTable;
+struct AliasTable {
+    int size;
+    uint32_t* threshold;
+    int* alias;
+};
+
+typedef struct WorkloadModel WorkloadModel;
+struct WorkloadModel {
+    WorkloadConfig config;
+    AliasTable items;
+    AliasTable cart_sizes;        // index i means a cart of cart_offset + i items
+    int cart_offset;
+    AliasTable calm_arrivals;
+    AliasTable burst_arrivals;
+    uint64_t burst_start_below;   // 53-bit draws below these switch state
+    uint64_t burst_end_below;
+    char** item_names;
+    char** customer_names;
+    char* name_storage;
+};
+
+typedef struct WorkloadRng WorkloadRng;
+struct WorkloadRng {
+    uint64_t state;
+};
+
+typedef struct Workload Workload;
+struct Workload {
+    WorkloadModel* model;
+    WorkloadRng rng;
+    bool bursting;
+    int next_name;
+};
+
+static uint64_t splitmix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+static void rng_seed(WorkloadRng* rng, uint64_t seed) {
+    rng->state = splitmix64(seed);
+    if (rng->state == 0) rng->state = 1;
+}
+
+/**
+ * xorshift64*: one multiply and three shifts per draw.
+ */
+static inline uint64_t rng_next(WorkloadRng* rng) {
+    uint64_t x = rng->state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    rng->state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+/**
+ * Uniform draw in [lo, hi] using a multiply-shift instead of a division.
+ */
+static inline int rng_range(WorkloadRng* rng, int lo, int hi) {
+    uint64_t span = (uint64_t)(hi - lo + 1);
+    return lo + (int)(((rng_next(rng) >> 32) * span) >> 32);
+}
+
+/**
+ * Turn a probability into a threshold for a 53-bit draw (rng_next() >> 11):
+ * the draw is below it with exactly that probability. p <= 0 gives 0 (never)
+ * and p >= 1 gives 2^53 (always), both of which fit in a uint64_t.
+ */
+static uint64_t probability_threshold(double p) {
+    if (!(p > 0)) return 0;
+    if (p >= 1) return (uint64_t)1 << 53;
+    return (uint64_t)(p * 9007199254740992.0);
+}
+
+/**
+ * Function: alias_init
+ * --------------------
+ * Build an alias table from size non-negative weights (they do not need to sum
+ * to 1). The weights array is used as scratch space and is clobbered.
+ */
+static void alias_init(AliasTable* table, double* weights, int size) {
+    table->size = size;
+    table->threshold = (uint32_t*)calloc((size_t)size, sizeof(uint32_t));
+    table->alias = (int*)calloc((size_t)size, sizeof(int));
+    int* small = (int*)calloc((size_t)size, sizeof(int));
+    int* large = (int*)calloc((size_t)size, sizeof(int));
+    if (table->threshold == NULL || table->alias == NULL || small == NULL || large == NULL) exit(1);
+
+    double sum = 0;
+    for (int i = 0; i < size; i++) sum += weights[i];
+
+    int small_count = 0;
+    int large_count = 0;
+    for (int i = 0; i < size; i++) {
+        weights[i] = weights[i] * size / sum;
+        if (weights[i] < 1.0) small[small_count++] = i;
+        else large[large_count++] = i;
+    }
+
+    while (small_count > 0 && large_count > 0) {
+        int s = small[--small_count];
+        int l = large[--large_count];
+        table->threshold[s] = (uint32_t)(weights[s] * 4294967295.0);
+        table->alias[s] = l;
+        weights[l] -= 1.0 - weights[s];
+        if (weights[l] < 1.0) small[small_count++] = l;
+        else large[large_count++] = l;
+    }
+    // Whatever is left over is 1.0 up to rounding error.
+    while (large_count > 0) {
+        int l = large[--large_count];
+        table->threshold[l] = UINT32_MAX;
+        table->alias[l] = l;
+    }
+    while (small_count > 0) {
+        int s = small[--small_count];
+        table->threshold[s] = UINT32_MAX;
+        table->alias[s] = s;
+    }
+
+    free(small);
+    free(large);
+}
+
+static inline int alias_sample(AliasTable* table, WorkloadRng* rng) {
+    uint64_t r = rng_next(rng);
+    int i = (int)(((r >> 32) * (uint64_t)table->size) >> 32);
+    return ((uint32_t)r < table->threshold[i]) ? i : table->alias[i];
+}
+
+static void alias_free(AliasTable* table) {
+    free(table->threshold);
+    free(table->alias);
+}
+
+/**
+ * Poisson arrivals per round, cut off far enough into the tail that the
+ * missing mass is negligible.
+ */
+static void arrivals_init(AliasTable* table, double rate) {
+    int size = (int)(rate + 10 * sqrt(rate + 1)) + 10;
+    double* weights = (double*)calloc((size_t)size, sizeof(double));
+    if (weights == NULL) exit(1);
+
+    weights[0] = exp(-rate);
+    for (int k = 1; k < size; k++) {
+        weights[k] = weights[k - 1] * rate / k;
+    }
+    alias_init(table, weights, size);
+    free(weights);
+}
+
+static void cart_sizes_init(WorkloadModel* model) {
+    WorkloadConfig* config = &model->config;
+    int lo = config->cart_min;
+    int hi = config->cart_max;
+    if (config->cart_distribution == WORKLOAD_CART_FIXED) hi = lo;
+    if (config->cart_distribution == WORKLOAD_CART_GEOMETRIC) lo = 1;
+
+    int size = hi - lo + 1;
+    double* weights = (double*)calloc((size_t)size, sizeof(double));
+    if (weights == NULL) exit(1);
+
+    // A geometric distribution on 1, 2, 3, ... with the requested mean.
+    double p = 1.0 / (config->cart_mean < 1 ? 1 : config->cart_mean);
+    double w = p;
+    for (int i = 0; i < size; i++) {
+        if (config->cart_distribution == WORKLOAD_CART_GEOMETRIC) {
+            weights[i] = w;
+            w *= 1 - p;
+        } else {
+            weights[i] = 1;
+        }
+    }
+    model->cart_offset = lo;
+    alias_init(&model->cart_sizes, weights, size);
+    free(weights);
+}
+
+/**
+ * Function: names_init
+ * --------------------
+ * Format every item and customer name once, back to back in a single buffer.
+ */
+static void names_init(WorkloadModel* model) {
+    WorkloadConfig* config = &model->config;
+    size_t item_bytes = (size_t)config->catalog_size * 16;
+    size_t customer_bytes = (size_t)config->name_pool_size * 20;
+
+    model->name_storage = (char*)malloc(item_bytes + customer_bytes);
+    model->item_names = (char**)calloc((size_t)config->catalog_size, sizeof(char*));
+    model->customer_names = (char**)calloc((size_t)config->name_pool_size, sizeof(char*));
+    if (model->name_storage == NULL || model->item_names == NULL || model->customer_names == NULL) exit(1);
+
+    char* p = model->name_storage;
+    for (int i = 0; i < config->catalog_size; i++) {
+        model->item_names[i] = p;
+        p += snprintf(p, 16, "item-%07d", i) + 1;
+    }
+    for (int i = 0; i < config->name_pool_size; i++) {
+        model->customer_names[i] = p;
+        p += snprintf(p, 20, "Shopper %d", i) + 1;
+    }
+}
+
+/**
+ * Function: workload_default_config
+ * ---------------------------------
+ * A store with 10 000 products, moderately skewed popularity, geometric carts
+ * averaging 6 items and occasional rushes at four times the usual rate.
+ */
+WorkloadConfig workload_default_config() {
+    WorkloadConfig config = {
+        10000,                     // catalog_size
+        1.1,                       // zipf_exponent
+        WORKLOAD_CART_GEOMETRIC,   // cart_distribution
+        1,                         // cart_min
+        64,                        // cart_max
+        6.0,                       // cart_mean
+        5,                         // max_amount
+        2.0,                       // calm_rate
+        8.0,                       // burst_rate
+        0.02,                      // burst_start
+        0.10,                      // burst_end
+        4096,                      // name_pool_size
+    };
+    return config;
+}
+
+/**
+ * Function: workload_model_init
+ * -----------------------------
+ * Validate the config and build every table the streams will sample from.
+ *
+ * Return false (and leave the model untouched) if the config is invalid.
+ */
+bool workload_model_init(WorkloadModel* model, WorkloadConfig* config) {
+    if (config->catalog_size < 1 || config->catalog_size > 9999999 ||
+        config->name_pool_size < 1 || config->max_amount < 1 ||
+        config->cart_min < 1 || config->cart_max < config->cart_min ||
+        config->zipf_exponent < 0 ||
+        config->calm_rate < 0 || config->calm_rate > WORKLOAD_MAX_RATE ||
+        config->burst_rate < 0 || config->burst_rate > WORKLOAD_MAX_RATE) {
+        return false;
+    }
+    memset(model, 0, sizeof(WorkloadModel));
+    model->config = *config;
+
+    double* weights = (double*)calloc((size_t)config->catalog_size, sizeof(double));
+    if (weights == NULL) exit(1);
+    for (int i = 0; i < config->catalog_size; i++) {
+        weights[i] = 1.0 / pow(i + 1, config->zipf_exponent);
+    }
+    alias_init(&model->items, weights, config->catalog_size);
+    free(weights);
+
+    cart_sizes_init(model);
+    arrivals_init(&model->calm_arrivals, config->calm_rate);
+    arrivals_init(&model->burst_arrivals, config->burst_rate);
+    model->burst_start_below = probability_threshold(config->burst_start);
+    model->burst_end_below = probability_threshold(config->burst_end);
+    names_init(model);
+    return true;
+}
+
+void workload_model_free(WorkloadModel* model) {
+    alias_free(&model->items);
+    alias_free(&model->cart_sizes);
+    alias_free(&model->calm_arrivals);
+    alias_free(&model->burst_arrivals);
+    free(model->item_names);
+    free(model->customer_names);
+    free(model->name_storage);
+}
+
+/**
+ * Function: workload_init
+ * -----------------------
+ * Start a new stream over a model. Two streams with the same model and seed
+ * produce exactly the same sequence of draws.
+ */
+void workload_init(Workload* workload, WorkloadModel* model, uint64_t seed) {
+    workload->model = model;
+    rng_seed(&workload->rng, seed);
+    workload->bursting = false;
+    workload->next_name = 0;
+}
+
+/**
+ * Function: workload_arrivals
+ * ---------------------------
+ * Advance the burst state by one round and return how many customers arrive.
+ */
+int workload_arrivals(Workload* workload) {
+    WorkloadModel* model = workload->model;
+    uint64_t r = rng_next(&workload->rng) >> 11;
+    if (workload->bursting) {
+        if (r < model->burst_end_below) workload->bursting = false;
+    } else {
+        if (r < model->burst_start_below) workload->bursting = true;
+    }
+    AliasTable* table = workload->bursting ? &model->burst_arrivals : &model->calm_arrivals;
+    return alias_sample(table, &workload->rng);
+}
+
+char* workload_customer_name(Workload* workload) {
+    char* name = workload->model->customer_names[workload->next_name];
+    if (++workload->next_name == workload->model->config.name_pool_size) workload->next_name = 0;
+    return name;
+}
+
+int workload_cart_size(Workload* workload) {
+    return workload->model->cart_offset + alias_sample(&workload->model->cart_sizes, &workload->rng);
+}
+
+char* workload_item(Workload* workload) {
+    return workload->model->item_names[alias_sample(&workload->model->items, &workload->rng)];
+}
+
+int workload_amount(Workload* workload) {
+    return rng_range(&workload->rng, 1, workload->model->config.max_amount);
+}
+
+int workload_lane(Workload* workload, int number_of_lanes) {
+    return rng_range(&workload->rng, 0, number_of_lanes - 1);
+}
+
+/**
+ * Function: workload_fill_cart
+ * ----------------------------
+ * Draw a cart size and add that many Zipf-distributed items to the customer.
+ * Popular items are often drawn twice, which exercises the merge path of
+ * add_item_to_cart(). Return the number of add_item_to_cart() calls made.
+ */
+int workload_fill_cart(Workload* workload, Customer* customer) {
+    int cart_size = workload_cart_size(workload);
+    for (int i = 0; i < cart_size; i++) {
+        add_item_to_cart(customer, workload_item(workload), workload_amount(workload));
+    }
+    return cart_size;
+}
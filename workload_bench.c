@@ -0,0 +1,114 @@
+/**
+ * Workload Generator Benchmark
+ *
+ * Times the generator on its own, then uses it to drive the store for the
+ * requested number of operations (every add_item_to_cart(), queue(),
+ * balance_lanes() and process() call counts as one). Comparing the two rates
+ * shows how much of a high-volume run is spent generating the workload.
+ *
+ * Build: gcc -O2 workload_bench.c -o workload_bench -lm
+ * Usage: ./workload_bench [operations] [seed] [lanes]
+ */
+#include "workload.c"
+#include <time.h>
+
+static double seconds_since(struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/**
+ * Function: generate_only
+ * -----------------------
+ * Make the same kinds of draws a store run makes, without touching the store.
+ * Return a checksum so the compiler cannot throw the draws away.
+ */
+static uint64_t generate_only(Workload* workload, long operations, int number_of_lanes) {
+    uint64_t checksum = 0;
+    long done = 0;
+    while (done < operations) {
+        int arriving = workload_arrivals(workload);
+        for (int i = 0; i < arriving; i++) {
+            checksum += (uintptr_t)workload_customer_name(workload);
+            int cart_size = workload_cart_size(workload);
+            for (int j = 0; j < cart_size; j++) {
+                checksum += (uintptr_t)workload_item(workload) + workload_amount(workload);
+            }
+            checksum += workload_lane(workload, number_of_lanes);
+            done += cart_size + 1;
+        }
+        done += 1 + number_of_lanes;
+    }
+    return checksum;
+}
+
+/**
+ * Function: drive_store
+ * ---------------------
+ * Run rounds of arrivals, one balance_lanes() and one process_all_lanes() until
+ * at least the given number of operations has been issued. Return the number of
+ * items checked out.
+ */
+static long drive_store(Workload* workload, long operations, int number_of_lanes, long* done) {
+    CheckoutLane** lanes = (CheckoutLane**)calloc((size_t)number_of_lanes, sizeof(CheckoutLane*));
+    if (lanes == NULL) exit(1);
+    for (int i = 0; i < number_of_lanes; i++) {
+        lanes[i] = open_new_checkout_line();
+    }
+
+    long items = 0;
+    *done = 0;
+    while (*done < operations) {
+        int arriving = workload_arrivals(workload);
+        for (int i = 0; i < arriving; i++) {
+            Customer* customer = new_customer(workload_customer_name(workload));
+            *done += workload_fill_cart(workload, customer);
+            queue(customer, lanes[workload_lane(workload, number_of_lanes)]);
+            *done += 1;
+        }
+        balance_lanes(lanes, number_of_lanes);
+        items += process_all_lanes(lanes, number_of_lanes);
+        *done += 1 + number_of_lanes;
+    }
+
+    close_store(lanes, number_of_lanes);
+    free(lanes);
+    return items;
+}
+
+int main(int argc, char* argv[]) {
+    long operations = argc > 1 ? atol(argv[1]) : 10000000;
+    uint64_t seed = argc > 2 ? strtoull(argv[2], NULL, 10) : 1;
+    int number_of_lanes = argc > 3 ? atoi(argv[3]) : 8;
+    if (operations < 1 || number_of_lanes < 1) {
+        fprintf(stderr, "usage: %s [operations] [seed] [lanes]\n", argv[0]);
+        return 1;
+    }
+
+    WorkloadConfig config = workload_default_config();
+    WorkloadModel model;
+    if (!workload_model_init(&model, &config)) exit(1);
+
+    Workload workload;
+    struct timespec start;
+
+    workload_init(&workload, &model, seed);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    uint64_t checksum = generate_only(&workload, operations, number_of_lanes);
+    double generate_time = seconds_since(&start);
+
+    long done = 0;
+    workload_init(&workload, &model, seed);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    long items = drive_store(&workload, operations, number_of_lanes, &done);
+    double store_time = seconds_since(&start);
+
+    printf("generator only: %ld ops in %.3f s, %.1f ns/op (checksum %llx)\n", operations,
+           generate_time, generate_time * 1e9 / operations, (unsigned long long)checksum);
+    printf("store driven:   %ld ops in %.3f s, %.1f ns/op, %ld items checked out\n", done,
+           store_time, store_time * 1e9 / done, items);
+
+    workload_model_free(&model);
+    return 0;
+}
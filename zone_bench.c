@@ -0,0 +1,174 @@
+/**
+ * Zoned Store Benchmark
+ *
+ * Fills a flat store and a zoned store with the same lanes and customers, then
+ * times three phases on both:
+ *
+ *   balance      balancing steps straight after filling, when every lane is
+ *                out of shape. A flat step walks every lane to move one
+ *                customer; a zoned step balances every zone at once, spread
+ *                over the worker threads.
+ *   steady       one new arrival then one balancing step, over and over. A
+ *                flat step still walks every lane; a zoned step only
+ *                rebalances the zone the customer joined.
+ *   process      serving every customer until the store is empty.
+ *
+ * Checks that both stores serve the same number of items.
+ *
+ * Build: gcc -O2 -pthread zone_bench.c -o zone_bench -lm
+ * Usage: ./zone_bench [zones] [lanes_per_zone] [customers_per_lane] [threads] [seed]
+ */
+#include "zones.c"
+#include "workload.c"
+#include <time.h>
+
+#define BALANCE_STEPS 64
+#define STEADY_STEPS 256
+
+static double seconds_since(struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/**
+ * Function: next_customer
+ * -----------------------
+ * Make the next customer of the workload and pick the (flat) lane it joins.
+ * The first quarter of the lanes get twice their share, so balancing has
+ * work to do both inside and across zones.
+ */
+static Customer* next_customer(Workload* workload, int total_lanes, int* lane) {
+    Customer* customer = new_customer(workload_customer_name(workload));
+    workload_fill_cart(workload, customer);
+    *lane = workload_lane(workload, total_lanes + total_lanes / 4) % total_lanes;
+    return customer;
+}
+
+int main(int argc, char* argv[]) {
+    int number_of_zones = argc > 1 ? atoi(argv[1]) : 64;
+    int lanes_per_zone = argc > 2 ? atoi(argv[2]) : 256;
+    int per_lane = argc > 3 ? atoi(argv[3]) : 8;
+    int threads = argc > 4 ? atoi(argv[4]) : 4;
+    uint64_t seed = argc > 5 ? strtoull(argv[5], NULL, 10) : 1;
+    if (number_of_zones < 1 || lanes_per_zone < 1 || per_lane < 1 || threads < 1) {
+        fprintf(stderr, "usage: %s [zones] [lanes_per_zone] [customers_per_lane] [threads] [seed]\n", argv[0]);
+        return 1;
+    }
+    int total_lanes = number_of_zones * lanes_per_zone;
+    int customers = total_lanes * per_lane;
+
+    WorkloadConfig config = workload_default_config();
+    config.cart_mean = 2.0;
+    WorkloadModel model;
+    if (!workload_model_init(&model, &config)) exit(1);
+    struct timespec start;
+
+    // Flat store: one array of every lane.
+    CheckoutLane** lanes = (CheckoutLane**)calloc((size_t)total_lanes, sizeof(CheckoutLane*));
+    if (lanes == NULL) exit(1);
+    for (int i = 0; i < total_lanes; i++) {
+        lanes[i] = open_new_checkout_line();
+    }
+    Workload workload;
+    workload_init(&workload, &model, seed);
+    for (int i = 0; i < customers; i++) {
+        int lane;
+        Customer* customer = next_customer(&workload, total_lanes, &lane);
+        queue(customer, lanes[lane]);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int flat_moves = 0;
+    for (int s = 0; s < BALANCE_STEPS; s++) {
+        if (balance_lanes(lanes, total_lanes)) flat_moves++;
+    }
+    double flat_balance_time = seconds_since(&start);
+
+    // Arrivals for the steady phase come from their own stream, so both
+    // stores get the same ones.
+    Workload arrivals;
+    workload_init(&arrivals, &model, seed + 1);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int s = 0; s < STEADY_STEPS; s++) {
+        int lane;
+        Customer* customer = next_customer(&arrivals, total_lanes, &lane);
+        queue(customer, lanes[lane]);
+        balance_lanes(lanes, total_lanes);
+    }
+    double flat_steady_time = seconds_since(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    long flat_total = 0;
+    while (true) {
+        bool any = false;
+        for (int i = 0; i < total_lanes && !any; i++) any = lanes[i]->first != NULL;
+        if (!any) break;
+        flat_total += process_all_lanes(lanes, total_lanes);
+    }
+    double flat_process_time = seconds_since(&start);
+    close_store(lanes, total_lanes);
+    free(lanes);
+
+    // Zoned store: the same lanes, zone z holding flat lanes z*L .. z*L+L-1.
+    int* lanes_per = (int*)calloc((size_t)number_of_zones, sizeof(int));
+    if (lanes_per == NULL) exit(1);
+    for (int z = 0; z < number_of_zones; z++) {
+        lanes_per[z] = lanes_per_zone;
+    }
+    ZonedStore* store = open_zoned_store(number_of_zones, lanes_per, 1, threads);
+    workload_init(&workload, &model, seed);
+    for (int i = 0; i < customers; i++) {
+        int lane;
+        Customer* customer = next_customer(&workload, total_lanes, &lane);
+        zoned_queue(store, lane / lanes_per_zone, lane % lanes_per_zone, customer);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int zoned_moves = 0;
+    for (int s = 0; s < BALANCE_STEPS; s++) {
+        zoned_moves += balance_zoned_store(store);
+    }
+    double zoned_balance_time = seconds_since(&start);
+
+    // Settle the zones first, so the steady phase starts from balanced zones
+    // as the flat store's (mostly balanced) lanes do.
+    while (balance_zoned_store(store) > 0) {
+    }
+    workload_init(&arrivals, &model, seed + 1);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int s = 0; s < STEADY_STEPS; s++) {
+        int lane;
+        Customer* customer = next_customer(&arrivals, total_lanes, &lane);
+        zoned_queue(store, lane / lanes_per_zone, lane % lanes_per_zone, customer);
+        balance_zoned_store(store);
+    }
+    double zoned_steady_time = seconds_since(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    long zoned_total = 0;
+    while (true) {
+        long left = 0;
+        for (int z = 0; z < number_of_zones; z++) left += store->zones[z].customers;
+        if (left == 0) break;
+        zoned_total += process_all_zones(store);
+    }
+    double zoned_process_time = seconds_since(&start);
+    close_zoned_store(store);
+    free(lanes_per);
+
+    printf("%d zones x %d lanes, %d customers, %d threads\n", number_of_zones, lanes_per_zone,
+           customers, threads);
+    printf("flat  balance: %8.3f ms/step, %5d moves in %d steps\n",
+           flat_balance_time * 1e3 / BALANCE_STEPS, flat_moves, BALANCE_STEPS);
+    printf("zoned balance: %8.3f ms/step, %5d moves in %d steps\n",
+           zoned_balance_time * 1e3 / BALANCE_STEPS, zoned_moves, BALANCE_STEPS);
+    printf("flat  steady:  %8.3f ms/step\n", flat_steady_time * 1e3 / STEADY_STEPS);
+    printf("zoned steady:  %8.3f ms/step\n", zoned_steady_time * 1e3 / STEADY_STEPS);
+    printf("flat  process: %8.3f s, %ld items\n", flat_process_time, flat_total);
+    printf("zoned process: %8.3f s, %ld items, %s\n", zoned_process_time, zoned_total,
+           zoned_total == flat_total ? "match" : "MISMATCH");
+
+    workload_model_free(&model);
+    return zoned_total == flat_total ? 0 : 1;
+}
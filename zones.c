@@ -0,0 +1,389 @@
+/**
+ * Zoned Store
+ *
+ * A store for venues too big for one flat CheckoutLane* array. Lanes are
+ * grouped into zones, and each zone owns its own lane array and keeps count of
+ * the customers queued in it.
+ *
+ * Zones share nothing, so process_all_zones() and the zone-local half of
+ * balance_zoned_store() hand whole zones to a pool of worker threads that the
+ * store starts when it opens and keeps until it closes. The calling thread
+ * works alongside them, so a store with no workers runs everything itself.
+ *
+ * Balancing runs balance_lanes() only in zones that changed since they were
+ * last found balanced: zoned_queue(), process_zone() and cross-zone moves mark
+ * a zone dirty, and a balance_lanes() that moves nobody marks it clean. So a
+ * balancing step costs the zones that changed, not the whole store. It moves
+ * a customer between zones only when the gap in customers per lane between
+ * the busiest and the quietest zone exceeds the store's escalation threshold.
+ * Zone totals are kept up to date, so choosing those two zones costs one pass
+ * over the zone counts.
+ *
+ * Queue through zoned_queue() and serve through process_zone() or
+ * process_all_zones() so that the zone totals stay right. A zone's lanes may
+ * be handed to any other store function, as long as it does not add or remove
+ * customers.
+ *
+ * The store is not locked. Only one call on a given store may run at a time.
+ * Handing work to the pool costs a wake-up per worker per call, a few
+ * microseconds, so calls are worth threading when zones hold real work.
+ *
+ * Link with -pthread.
+ */
+#ifndef ZONES_C
+#define ZONES_C
+
+#include "wackystore.c"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+typedef struct Zone Zone;
+struct Zone {
+    CheckoutLane** lanes;
+    int number_of_lanes;
+    long customers;          // customers queued in this zone's lanes
+    bool dirty;              // changed since balance_lanes() last moved nobody
+};
+
+typedef int (*ZoneJob)(Zone* zone);
+
+typedef struct ZonedStore ZonedStore;
+struct ZonedStore {
+    Zone* zones;
+    int number_of_zones;
+    int escalation_threshold;   // customers per lane, at least 1
+
+    // Worker pool. A job is handed out by bumping generation.
+    int number_of_workers;
+    pthread_t* workers;
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;
+    pthread_cond_t work_done;
+    uint64_t generation;
+    int busy_workers;
+    bool stopping;
+    ZoneJob job;
+    atomic_int next_zone;
+    int* results;               // per zone, summed in zone order
+};
+
+static void* zone_worker_main(void* arg);
+
+/**
+ * Function: open_zoned_store
+ * --------------------------
+ * Open a store of number_of_zones zones, where zone z has lanes_per_zone[z]
+ * new, empty lanes, and start threads - 1 worker threads (none if threads <= 1)
+ * to share zone work with the calling thread.
+ *
+ * Customers move between zones only when the busiest zone has more than
+ * escalation_threshold customers per lane above the quietest one. A threshold
+ * below 1 is raised to 1, so a move never just reverses the previous one.
+ *
+ * Return NULL if there are no zones or a zone has no lanes.
+ */
+ZonedStore* open_zoned_store(int number_of_zones, int lanes_per_zone[], int escalation_threshold,
+                             int threads) {
+    if (number_of_zones < 1) return NULL;
+    for (int z = 0; z < number_of_zones; z++) {
+        if (lanes_per_zone[z] < 1) return NULL;
+    }
+
+    ZonedStore* store = (ZonedStore*)calloc(1, sizeof(ZonedStore));
+    if (store == NULL) exit(1);
+    store->zones = (Zone*)calloc((size_t)number_of_zones, sizeof(Zone));
+    if (store->zones == NULL) exit(1);
+    store->number_of_zones = number_of_zones;
+    store->escalation_threshold = escalation_threshold < 1 ? 1 : escalation_threshold;
+
+    for (int z = 0; z < number_of_zones; z++) {
+        Zone* zone = &store->zones[z];
+        zone->lanes = (CheckoutLane**)calloc((size_t)lanes_per_zone[z], sizeof(CheckoutLane*));
+        if (zone->lanes == NULL) exit(1);
+        zone->number_of_lanes = lanes_per_zone[z];
+        for (int i = 0; i < zone->number_of_lanes; i++) {
+            zone->lanes[i] = open_new_checkout_line();
+        }
+    }
+
+    store->results = (int*)calloc((size_t)number_of_zones, sizeof(int));
+    if (store->results == NULL) exit(1);
+    if (threads > number_of_zones) threads = number_of_zones;
+    store->number_of_workers = threads > 1 ? threads - 1 : 0;
+    pthread_mutex_init(&store->lock, NULL);
+    pthread_cond_init(&store->work_ready, NULL);
+    pthread_cond_init(&store->work_done, NULL);
+    if (store->number_of_workers > 0) {
+        store->workers = (pthread_t*)calloc((size_t)store->number_of_workers, sizeof(pthread_t));
+        if (store->workers == NULL) exit(1);
+        for (int t = 0; t < store->number_of_workers; t++) {
+            if (pthread_create(&store->workers[t], NULL, zone_worker_main, store) != 0) exit(1);
+        }
+    }
+    return store;
+}
+
+/**
+ * Function: zoned_queue
+ * ---------------------
+ * queue() the customer at the end of the given lane of the given zone.
+ * Out-of-range zones and lanes are ignored.
+ */
+void zoned_queue(ZonedStore* store, int zone, int lane, Customer* customer) {
+    if (customer == NULL || zone < 0 || zone >= store->number_of_zones) return;
+    Zone* target = &store->zones[zone];
+    if (lane < 0 || lane >= target->number_of_lanes) return;
+
+    queue(customer, target->lanes[lane]);
+    target->customers++;
+    target->dirty = true;
+}
+
+/**
+ * Function: process_zone
+ * ----------------------
+ * process_all_lanes() over the zone's lanes, keeping the zone's customer count
+ * up to date.
+ */
+int process_zone(Zone* zone) {
+    int counter = 0;
+    for (int i = 0; i < zone->number_of_lanes; i++) {
+        if (zone->lanes[i]->first == NULL) continue;
+        counter += process(zone->lanes[i]);
+        zone->customers--;
+        zone->dirty = true;
+    }
+    return counter;
+}
+
+/**
+ * Function: balance_zone
+ * ----------------------
+ * balance_lanes() within the zone, unless the zone has not changed since it
+ * was last found balanced. The zone's customer count does not change.
+ */
+bool balance_zone(Zone* zone) {
+    if (!zone->dirty) return false;
+    bool moved = balance_lanes(zone->lanes, zone->number_of_lanes);
+    if (!moved) zone->dirty = false;
+    return moved;
+}
+
+// Claim zones one at a time until none are left, so a slow zone does not
+// hold up the others.
+static void zone_run_claimed(ZonedStore* store) {
+    int z;
+    while ((z = atomic_fetch_add(&store->next_zone, 1)) < store->number_of_zones) {
+        store->results[z] = store->job(&store->zones[z]);
+    }
+}
+
+static void* zone_worker_main(void* arg) {
+    ZonedStore* store = (ZonedStore*)arg;
+    uint64_t seen = 0;
+
+    pthread_mutex_lock(&store->lock);
+    while (true) {
+        while (!store->stopping && store->generation == seen) {
+            pthread_cond_wait(&store->work_ready, &store->lock);
+        }
+        if (store->stopping) break;
+        seen = store->generation;
+        pthread_mutex_unlock(&store->lock);
+
+        zone_run_claimed(store);
+
+        pthread_mutex_lock(&store->lock);
+        if (--store->busy_workers == 0) pthread_cond_signal(&store->work_done);
+    }
+    pthread_mutex_unlock(&store->lock);
+    return NULL;
+}
+
+/**
+ * Function: run_zones
+ * -------------------
+ * Run job on every zone, on the calling thread and the store's workers, and
+ * return the sum of the results.
+ */
+static int run_zones(ZonedStore* store, ZoneJob job) {
+    store->job = job;
+    atomic_store(&store->next_zone, 0);
+    if (store->number_of_workers > 0) {
+        pthread_mutex_lock(&store->lock);
+        store->busy_workers = store->number_of_workers;
+        store->generation++;
+        pthread_cond_broadcast(&store->work_ready);
+        pthread_mutex_unlock(&store->lock);
+    }
+
+    zone_run_claimed(store);
+
+    if (store->number_of_workers > 0) {
+        pthread_mutex_lock(&store->lock);
+        while (store->busy_workers > 0) {
+            pthread_cond_wait(&store->work_done, &store->lock);
+        }
+        pthread_mutex_unlock(&store->lock);
+    }
+
+    // Sum in zone order so the total does not depend on scheduling.
+    int counter = 0;
+    for (int z = 0; z < store->number_of_zones; z++) {
+        counter += store->results[z];
+    }
+    return counter;
+}
+
+/**
+ * Function: process_all_zones
+ * ---------------------------
+ * process_zone() every zone once, sharing the zones with the store's workers,
+ * and return the sum of the results. Same total as process_all_lanes() over
+ * every lane.
+ */
+int process_all_zones(ZonedStore* store) {
+    return run_zones(store, process_zone);
+}
+
+static int balance_zone_job(Zone* zone) {
+    return balance_zone(zone) ? 1 : 0;
+}
+
+/**
+ * Function: zone_lane_by_busyness
+ * -------------------------------
+ * Return the index of the zone's most busy lane, or of its least busy one if
+ * most is false. Ties go to the lane that comes first, as in balance_lanes().
+ */
+static int zone_lane_by_busyness(Zone* zone, bool most) {
+    int chosen = 0;
+    int chosen_busyness = total_number_of_customers(zone->lanes[0]);
+    for (int i = 1; i < zone->number_of_lanes; i++) {
+        int busyness = total_number_of_customers(zone->lanes[i]);
+        if (most ? busyness > chosen_busyness : busyness < chosen_busyness) {
+            chosen = i;
+            chosen_busyness = busyness;
+        }
+    }
+    return chosen;
+}
+
+/**
+ * Function: balance_across_zones
+ * ------------------------------
+ * Find the busiest and quietest zones by customers per lane. If the gap
+ * between them exceeds the escalation threshold, move the customer at the end
+ * of the busiest lane of the busiest zone to the end of the least busy lane of
+ * the quietest zone.
+ *
+ * Return true if and only if a customer was moved.
+ */
+static bool balance_across_zones(ZonedStore* store) {
+    if (store->number_of_zones < 2) return false;
+
+    // Compare customers / lanes without dividing: a/b > c/d  <=>  a*d > c*b.
+    int busiest = 0;
+    int quietest = 0;
+    for (int z = 1; z < store->number_of_zones; z++) {
+        Zone* zone = &store->zones[z];
+        if ((long long)zone->customers * store->zones[busiest].number_of_lanes >
+            (long long)store->zones[busiest].customers * zone->number_of_lanes) {
+            busiest = z;
+        }
+        if ((long long)zone->customers * store->zones[quietest].number_of_lanes <
+            (long long)store->zones[quietest].customers * zone->number_of_lanes) {
+            quietest = z;
+        }
+    }
+
+    Zone* from = &store->zones[busiest];
+    Zone* to = &store->zones[quietest];
+    long long gap = (long long)from->customers * to->number_of_lanes -
+                    (long long)to->customers * from->number_of_lanes;
+    if (gap <= (long long)store->escalation_threshold * from->number_of_lanes * to->number_of_lanes) {
+        return false;
+    }
+
+    CheckoutLane* from_lane = from->lanes[zone_lane_by_busyness(from, true)];
+    CheckoutLane* to_lane = to->lanes[zone_lane_by_busyness(to, false)];
+    TRACE_BEGIN("balance_across_zones", from_lane->id, 0);
+
+    CheckoutLaneNode* p = from_lane->last;
+    if (p == from_lane->first) {
+        from_lane->first = NULL;
+        from_lane->last = NULL;
+    } else {
+        from_lane->last = p->front;
+        from_lane->last->back = NULL;
+    }
+    queue(p->customer, to_lane);
+    from->customers--;
+    to->customers++;
+    from->dirty = true;
+    to->dirty = true;
+    // The end event names the lane the customer moved to.
+    TRACE_END("balance_across_zones", to_lane->id, p->customer->id);
+    free(p);
+    return true;
+}
+
+/**
+ * Function: balance_zoned_store
+ * -----------------------------
+ * balance_zone() every zone that changed, sharing them with the store's
+ * workers, then move one customer between zones if the zones are further
+ * apart than the escalation threshold allows.
+ *
+ * Return the number of customers moved.
+ */
+int balance_zoned_store(ZonedStore* store) {
+    int moved = 0;
+    int dirty = 0;
+    int dirty_zone = 0;
+    for (int z = 0; z < store->number_of_zones; z++) {
+        if (store->zones[z].dirty) {
+            dirty++;
+            dirty_zone = z;
+        }
+    }
+    // Waking the workers costs more than balancing a single zone ourselves.
+    if (dirty == 1) {
+        if (balance_zone(&store->zones[dirty_zone])) moved++;
+    } else if (dirty > 1) {
+        moved = run_zones(store, balance_zone_job);
+    }
+    if (balance_across_zones(store)) moved++;
+    return moved;
+}
+
+/**
+ * Function: close_zoned_store
+ * ---------------------------
+ * Stop the store's workers, close_store() every zone, then free the store
+ * itself.
+ */
+void close_zoned_store(ZonedStore* store) {
+    pthread_mutex_lock(&store->lock);
+    store->stopping = true;
+    pthread_cond_broadcast(&store->work_ready);
+    pthread_mutex_unlock(&store->lock);
+    for (int t = 0; t < store->number_of_workers; t++) {
+        pthread_join(store->workers[t], NULL);
+    }
+    pthread_mutex_destroy(&store->lock);
+    pthread_cond_destroy(&store->work_ready);
+    pthread_cond_destroy(&store->work_done);
+    free(store->workers);
+    free(store->results);
+
+    for (int z = 0; z < store->number_of_zones; z++) {
+        close_store(store->zones[z].lanes, store->zones[z].number_of_lanes);
+        free(store->zones[z].lanes);
+    }
+    free(store->zones);
+    free(store);
+}
+
+#endif